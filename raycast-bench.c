@@ -0,0 +1,767 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs every ray kernel the game has had over the same random rays and maps,
+// times them and checks where they stop against an exact grid traversal.
+
+#define DEFAULT_TILE_SIZE 64
+#define MIN_TILE_SIZE 8
+#define MAX_TILE_SIZE 256
+#define VIEW_DISTANCE_TILES 10  // Rays give up after this many tiles, same as the game
+#define MAX_DIST_FIELD 255
+#define DEFAULT_RAYS 200000
+#define MAX_RAYS 10000000
+#define BENCH_REPEATS 5  // Timings are the best of this many runs
+#define MAP_COUNT 4
+#define LAYOUT_RAYS 100000  // Rays per direction in the layout comparison
+#define LAYOUT_WALLS 10     // Percent of wall tiles in the layout comparison maps
+
+// Orders the game can keep its ray caster's copy of the map in
+#define GRID_ROWS 0
+#define GRID_BLOCKS 1    // GRID_BLOCK x GRID_BLOCK tiles, one cache line each, in rows of blocks
+#define GRID_MORTON 2    // Z-order inside power-of-two squares, in rows of squares
+#define GRID_LAYOUTS 3
+#define GRID_BLOCK 8
+#define GRID_MORTON_MAX 64  // Largest Z-order square, keeps the padding under one square
+
+typedef struct {
+    float x, y;
+    float angle;
+} Player;
+
+typedef struct {
+    const char* name;
+    int width, height;
+    Uint8* tiles;      // width * height tiles, row-major, 1 is a wall
+    Uint8* distField;  // Distance in tiles to the nearest wall (8-neighbour), 0 on walls
+    Uint8* cells;      // Distance field again in another order, 0 on walls, at cellX[x] + cellY[y]
+    Uint32* cellX;
+    Uint32* cellY;
+} Map;
+
+// Where a ray stopped; mapX is -1 when it ran out of range without hitting a wall
+typedef struct {
+    float distance;
+    int mapX, mapY;
+    int face;   // 0 west, 1 east, 2 north, 3 south, same order as the game's lightmaps
+    int cells;  // Points or tiles it looked at to get there
+} RayHit;
+
+typedef struct {
+    double distance;
+    int mapX, mapY;
+    int face;
+} ExactHit;
+
+typedef struct {
+    const char* name;
+    const char* from;
+    void (*cast)(Map* m, Player* ray, RayHit* hit);
+    bool onlyDefaultTile;  // Has the default tile size built in
+} Kernel;
+
+// What one kernel did on one map
+typedef struct {
+    double nsPerRay;
+    double cellsPerRay;
+    int compared;   // Rays that don't end right at the edge of the view distance
+    int tileMisses; // Stopped in a different tile than the exact traversal, or not at all
+    int faceMisses; // Right tile, wrong face
+    int overshoots; // Right tile, but more than one unit past the face
+    double errorSum, errorMax;
+    int sameAsUnit; // Bit for bit the same stop as the legacy unit stepper
+} KernelResult;
+
+int tileSize = DEFAULT_TILE_SIZE;
+int viewDistance = VIEW_DISTANCE_TILES * DEFAULT_TILE_SIZE;
+
+// The classic map from raycastv-3.51.c to raycastv-4.02.c
+const Uint8 classicTiles[8 * 10] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 0, 0, 0, 0, 0, 1, 0, 0, 1,
+    1, 0, 0, 0, 0, 1, 1, 0, 0, 1,
+    1, 0, 0, 1, 0, 0, 0, 0, 0, 1,
+    1, 0, 0, 1, 0, 0, 0, 0, 0, 1,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+Uint64 mixHash(Uint64 v) {
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+}
+
+// Deterministic random numbers, so every kernel and every run sees the same rays
+Uint64 randomState;
+
+Uint32 nextRandom(void) {
+    randomState = mixHash(randomState);
+    return (Uint32)(randomState >> 32);
+}
+
+float randomUnit(void) {
+    return (nextRandom() >> 8) / 16777216.0f;
+}
+
+void buildDistanceField(Map* m) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = w - 1; x >= 0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+bool allocMap(Map* m, const char* name, int width, int height) {
+    m->name = name;
+    m->width = width;
+    m->height = height;
+    m->tiles = calloc((size_t)width * height, 1);
+    m->distField = calloc((size_t)width * height, 1);
+    return m->tiles != NULL && m->distField != NULL;
+}
+
+void freeMap(Map* m) {
+    free(m->tiles);
+    free(m->distField);
+    free(m->cells);
+    free(m->cellX);
+    free(m->cellY);
+    m->cells = NULL;
+    m->cellX = m->cellY = NULL;
+}
+
+const char* gridLayoutNames[GRID_LAYOUTS] = { "rows", "blocks", "morton" };
+
+// Spread the low 16 bits out to the even bits
+Uint32 spreadBits(Uint32 v) {
+    v &= 0xFFFF;
+    v = (v | v << 8) & 0x00FF00FF;
+    v = (v | v << 4) & 0x0F0F0F0F;
+    v = (v | v << 2) & 0x33333333;
+    v = (v | v << 1) & 0x55555555;
+    return v;
+}
+
+// Copy the distance field into cells in the given order. Every order is a
+// sum of a column offset and a row offset, so one lookup works for all.
+bool setGridLayout(Map* m, int layout) {
+    int w = m->width, h = m->height;
+    int block = 1;
+    if (layout == GRID_BLOCKS) {
+        block = GRID_BLOCK;
+    } else if (layout == GRID_MORTON) {
+        while (block < w && block < h && block < GRID_MORTON_MAX) block *= 2;
+    }
+    size_t blocksWide = (w + block - 1) / block, blocksHigh = (h + block - 1) / block;
+    size_t size = layout == GRID_ROWS ? (size_t)w * h : blocksWide * blocksHigh * block * block;
+    free(m->cells);
+    free(m->cellX);
+    free(m->cellY);
+    m->cells = malloc(size);
+    m->cellX = malloc(w * sizeof(Uint32));
+    m->cellY = malloc(h * sizeof(Uint32));
+    if (m->cells == NULL || m->cellX == NULL || m->cellY == NULL) return false;
+    for (int x = 0; x < w; x++) {
+        if (layout == GRID_ROWS) m->cellX[x] = x;
+        if (layout == GRID_BLOCKS) m->cellX[x] = x / block * block * block + x % block;
+        if (layout == GRID_MORTON) m->cellX[x] = x / block * block * block + spreadBits(x % block);
+    }
+    for (int y = 0; y < h; y++) {
+        if (layout == GRID_ROWS) m->cellY[y] = (size_t)y * w;
+        if (layout == GRID_BLOCKS) m->cellY[y] = y / block * blocksWide * block * block + y % block * block;
+        if (layout == GRID_MORTON) m->cellY[y] = y / block * blocksWide * block * block + (spreadBits(y % block) << 1);
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int d = m->distField[(size_t)y * w + x];
+            m->cells[m->cellX[x] + m->cellY[y]] = m->tiles[(size_t)y * w + x] == 1 ? 0 : d > 0 ? d : 1;
+        }
+    }
+    return true;
+}
+
+void addBorder(Map* m) {
+    for (int x = 0; x < m->width; x++) {
+        m->tiles[x] = 1;
+        m->tiles[(size_t)(m->height - 1) * m->width + x] = 1;
+    }
+    for (int y = 0; y < m->height; y++) {
+        m->tiles[(size_t)y * m->width] = 1;
+        m->tiles[(size_t)y * m->width + m->width - 1] = 1;
+    }
+}
+
+// The maps every kernel runs on: the old built-in map, a big open one where
+// skipping pays off, a cluttered one, and diagonal walls of tiles that only
+// touch at their corners, which a stepping ray can slip through.
+bool makeMaps(Map* maps) {
+    if (!allocMap(&maps[0], "classic", 10, 8)) return false;
+    memcpy(maps[0].tiles, classicTiles, sizeof(classicTiles));
+
+    if (!allocMap(&maps[1], "open", 256, 256)) return false;
+    for (int y = 16; y < 256; y += 32) {
+        for (int x = 16; x < 256; x += 32) maps[1].tiles[y * 256 + x] = 1;
+    }
+
+    if (!allocMap(&maps[2], "cluttered", 256, 256)) return false;
+    for (int i = 0; i < 256 * 256; i++) maps[2].tiles[i] = nextRandom() % 100 < 30;
+
+    if (!allocMap(&maps[3], "diagonal", 128, 128)) return false;
+    for (int y = 0; y < 128; y++) {
+        for (int x = 0; x < 128; x++) maps[3].tiles[y * 128 + x] = (x + y) % 8 == 0 || (x - y + 128) % 12 == 0;
+    }
+
+    for (int i = 0; i < MAP_COUNT; i++) {
+        addBorder(&maps[i]);
+        buildDistanceField(&maps[i]);
+    }
+    return true;
+}
+
+static inline __attribute__((always_inline)) bool isWallAt(Map* m, int x, int y, int tile) {
+    int mapX = x / tile;
+    int mapY = y / tile;
+    if (mapX >= 0 && mapX < m->width && mapY >= 0 && mapY < m->height) {
+        return m->tiles[(size_t)mapY * m->width + mapX] == 1;
+    }
+    return false;
+}
+
+// Which tile and face the last step went into, the same way the game works it out
+static inline __attribute__((always_inline)) void stepHit(Map* m, RayHit* hit, float rayX, float rayY,
+    float prevX, float prevY, int tile) {
+    hit->mapX = -1;
+    if (isWallAt(m, rayX, rayY, tile)) {
+        int hitX = (int)rayX / tile;
+        int hitY = (int)rayY / tile;
+        int fromX = (int)prevX / tile;
+        hit->mapX = hitX;
+        hit->mapY = hitY;
+        if (fromX != hitX) {
+            hit->face = hitX > fromX ? 0 : 1;
+        } else {
+            hit->face = (int)rayY / tile > (int)prevY / tile ? 2 : 3;
+        }
+    }
+}
+
+// raycastv-2.c to raycastv-4.02.c: one unit at a time until the ray is inside
+// a wall. It can cut across the corner of a wall tile, and slip between two
+// walls that only touch at a corner.
+void castRayUnit(Map* m, Player* ray, RayHit* hit) {
+    float rayX = ray->x;
+    float rayY = ray->y;
+    float prevX = rayX;
+    float prevY = rayY;
+    float distance = 0;
+    int cells = 1;
+
+    while (!isWallAt(m, rayX, rayY, tileSize) && distance < viewDistance) {
+        prevX = rayX;
+        prevY = rayY;
+        rayX += cos(ray->angle * M_PI / 180);
+        rayY += sin(ray->angle * M_PI / 180);
+        distance += 1;
+        cells++;
+    }
+
+    hit->distance = distance;
+    hit->cells = cells;
+    stepHit(m, hit, rayX, rayY, prevX, prevY, tileSize);
+}
+
+// raycastv-4.03.c onwards: the same unit steps near walls, but whole tiles of
+// open space at once going by the distance field
+static inline __attribute__((always_inline)) void distFieldKernel(Map* m, Player* ray, RayHit* hit,
+    int tile, int reach) {
+    float rayX = ray->x;
+    float rayY = ray->y;
+    float prevX = rayX;
+    float prevY = rayY;
+    float stepX = cos(ray->angle * M_PI / 180);
+    float stepY = sin(ray->angle * M_PI / 180);
+    float distance = 0;
+    int cells = 1;
+
+    while (!isWallAt(m, rayX, rayY, tile) && distance < reach) {
+        int step = 1;
+        int mapX = (int)rayX / tile;
+        int mapY = (int)rayY / tile;
+        if (rayX >= 0 && rayY >= 0 && mapX < m->width && mapY < m->height) {
+            int d = m->distField[mapY * m->width + mapX];
+            if (d > 1) {
+                step = (d - 1) * tile;
+                if (distance + step > reach) step = reach - distance;
+                if (step < 1) step = 1;
+            }
+        }
+        prevX = rayX;
+        prevY = rayY;
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+        cells++;
+    }
+
+    hit->distance = distance;
+    hit->cells = cells;
+    stepHit(m, hit, rayX, rayY, prevX, prevY, tile);
+}
+
+void castRayDistField(Map* m, Player* ray, RayHit* hit) {
+    distFieldKernel(m, ray, hit, tileSize, viewDistance);
+}
+
+// raycastv-4.20.c onwards picks this one for the default tile size
+void castRayDistField64(Map* m, Player* ray, RayHit* hit) {
+    distFieldKernel(m, ray, hit, 64, VIEW_DISTANCE_TILES * 64);
+}
+
+// A candidate: visits exactly the tiles the ray crosses, one per step, and
+// stops on the face it enters through
+void castRayGrid(Map* m, Player* ray, RayHit* hit) {
+    float dirX = cos(ray->angle * M_PI / 180);
+    float dirY = sin(ray->angle * M_PI / 180);
+    int mapX = (int)ray->x / tileSize;
+    int mapY = (int)ray->y / tileSize;
+    int stepX = dirX < 0 ? -1 : 1;
+    int stepY = dirY < 0 ? -1 : 1;
+    float deltaX = dirX != 0 ? fabsf(tileSize / dirX) : INFINITY;
+    float deltaY = dirY != 0 ? fabsf(tileSize / dirY) : INFINITY;
+    float nextX = dirX != 0 ? ((mapX + (stepX > 0)) * tileSize - ray->x) / dirX : INFINITY;
+    float nextY = dirY != 0 ? ((mapY + (stepY > 0)) * tileSize - ray->y) / dirY : INFINITY;
+    float distance = 0;
+    int cells = 1;
+    int face = 0;
+
+    hit->mapX = -1;
+    while (mapX >= 0 && mapY >= 0 && mapX < m->width && mapY < m->height) {
+        if (m->tiles[(size_t)mapY * m->width + mapX] == 1) {
+            hit->mapX = mapX;
+            hit->mapY = mapY;
+            hit->face = face;
+            break;
+        }
+        if (nextX < nextY) {
+            distance = nextX;
+            nextX += deltaX;
+            mapX += stepX;
+            face = stepX > 0 ? 0 : 1;
+        } else {
+            distance = nextY;
+            nextY += deltaY;
+            mapY += stepY;
+            face = stepY > 0 ? 2 : 3;
+        }
+        if (distance > viewDistance) {
+            distance = viewDistance;
+            break;
+        }
+        cells++;
+    }
+    hit->distance = distance;
+    hit->cells = cells;
+}
+
+// The reference: the same grid traversal in double precision, starting from
+// the exact direction, and with no view distance
+void traceExact(Map* m, Player* ray, ExactHit* hit) {
+    double dirX = cos(ray->angle * M_PI / 180);
+    double dirY = sin(ray->angle * M_PI / 180);
+    int mapX = (int)floor(ray->x / tileSize);
+    int mapY = (int)floor(ray->y / tileSize);
+    int stepX = dirX < 0 ? -1 : 1;
+    int stepY = dirY < 0 ? -1 : 1;
+    double nextX = dirX != 0 ? ((double)(mapX + (stepX > 0)) * tileSize - ray->x) / dirX : INFINITY;
+    double nextY = dirY != 0 ? ((double)(mapY + (stepY > 0)) * tileSize - ray->y) / dirY : INFINITY;
+    double distance = 0;
+    int face = 0;
+
+    hit->mapX = -1;
+    while (mapX >= 0 && mapY >= 0 && mapX < m->width && mapY < m->height) {
+        if (m->tiles[(size_t)mapY * m->width + mapX] == 1) {
+            hit->mapX = mapX;
+            hit->mapY = mapY;
+            hit->face = face;
+            break;
+        }
+        // Recomputed from the start instead of accumulated, so there is no drift
+        if (nextX < nextY) {
+            distance = nextX;
+            mapX += stepX;
+            nextX = ((double)(mapX + (stepX > 0)) * tileSize - ray->x) / dirX;
+            face = stepX > 0 ? 0 : 1;
+        } else {
+            distance = nextY;
+            mapY += stepY;
+            nextY = ((double)(mapY + (stepY > 0)) * tileSize - ray->y) / dirY;
+            face = stepY > 0 ? 2 : 3;
+        }
+    }
+    hit->distance = distance;
+}
+
+// The distfield kernel reading the map through cells, whatever their order
+void castRayDistFieldCells(Map* m, Player* ray, RayHit* hit) {
+    int tile = tileSize, reach = viewDistance;
+    float rayX = ray->x;
+    float rayY = ray->y;
+    float prevX = rayX;
+    float prevY = rayY;
+    float stepX = cos(ray->angle * M_PI / 180);
+    float stepY = sin(ray->angle * M_PI / 180);
+    float distance = 0;
+    int cells = 1;
+    int d = 1;
+
+    while (distance < reach) {
+        int mapX = (int)rayX / tile;
+        int mapY = (int)rayY / tile;
+        d = mapX >= 0 && mapX < m->width && mapY >= 0 && mapY < m->height ? m->cells[m->cellX[mapX] + m->cellY[mapY]] : 1;
+        if (d == 0) break;
+        int step = 1;
+        if (d > 1 && rayX >= 0 && rayY >= 0) {
+            step = (d - 1) * tile;
+            if (distance + step > reach) step = reach - distance;
+            if (step < 1) step = 1;
+        }
+        prevX = rayX;
+        prevY = rayY;
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+        cells++;
+    }
+
+    hit->distance = distance;
+    hit->cells = cells;
+    stepHit(m, hit, rayX, rayY, prevX, prevY, tile);
+}
+
+// The grid walk reading the map through cells
+void castRayGridCells(Map* m, Player* ray, RayHit* hit) {
+    float dirX = cos(ray->angle * M_PI / 180);
+    float dirY = sin(ray->angle * M_PI / 180);
+    int mapX = (int)ray->x / tileSize;
+    int mapY = (int)ray->y / tileSize;
+    int stepX = dirX < 0 ? -1 : 1;
+    int stepY = dirY < 0 ? -1 : 1;
+    float deltaX = dirX != 0 ? fabsf(tileSize / dirX) : INFINITY;
+    float deltaY = dirY != 0 ? fabsf(tileSize / dirY) : INFINITY;
+    float nextX = dirX != 0 ? ((mapX + (stepX > 0)) * tileSize - ray->x) / dirX : INFINITY;
+    float nextY = dirY != 0 ? ((mapY + (stepY > 0)) * tileSize - ray->y) / dirY : INFINITY;
+    float distance = 0;
+    int cells = 1;
+    int face = 0;
+
+    hit->mapX = -1;
+    while (mapX >= 0 && mapY >= 0 && mapX < m->width && mapY < m->height) {
+        if (m->cells[m->cellX[mapX] + m->cellY[mapY]] == 0) {
+            hit->mapX = mapX;
+            hit->mapY = mapY;
+            hit->face = face;
+            break;
+        }
+        if (nextX < nextY) {
+            distance = nextX;
+            nextX += deltaX;
+            mapX += stepX;
+            face = stepX > 0 ? 0 : 1;
+        } else {
+            distance = nextY;
+            nextY += deltaY;
+            mapY += stepY;
+            face = stepY > 0 ? 2 : 3;
+        }
+        if (distance > viewDistance) {
+            distance = viewDistance;
+            break;
+        }
+        cells++;
+    }
+    hit->distance = distance;
+    hit->cells = cells;
+}
+
+Kernel kernels[] = {
+    { "unit", "raycastv-2.c to 4.02", castRayUnit, false },
+    { "distfield", "raycastv-4.03 onwards", castRayDistField, false },
+    { "distfield64", "raycastv-4.20 onwards", castRayDistField64, true },
+    { "grid", "candidate", castRayGrid, false },
+};
+#define KERNEL_COUNT (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+// Random starting points in open tiles, pointing any way
+void makeRays(Map* m, Player* rays, int count) {
+    for (int i = 0; i < count; i++) {
+        int mapX, mapY;
+        do {
+            mapX = nextRandom() % m->width;
+            mapY = nextRandom() % m->height;
+        } while (m->tiles[(size_t)mapY * m->width + mapX] == 1);
+        rays[i].x = (mapX + randomUnit()) * tileSize;
+        rays[i].y = (mapY + randomUnit()) * tileSize;
+        rays[i].angle = randomUnit() * 360;
+    }
+}
+
+// Like makeRays, but every ray points within 10 degrees of one of the
+// given directions
+void makeAimedRays(Map* m, Player* rays, int count, const float* directions, int directionCount) {
+    makeRays(m, rays, count);
+    for (int i = 0; i < count; i++) {
+        rays[i].angle = directions[nextRandom() % directionCount] + (randomUnit() - 0.5f) * 20;
+    }
+}
+
+// Time a kernel on rays that are already set up, best of BENCH_REPEATS
+double timeKernel(void (*cast)(Map* m, Player* ray, RayHit* hit), Map* m, Player* rays, RayHit* hits, int count) {
+    Uint64 best = 0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < count; i++) {
+            cast(m, &rays[i], &hits[i]);
+        }
+        Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    return (double)best * 1e9 / SDL_GetPerformanceFrequency() / count;
+}
+
+// How much the order of the map in memory matters. Rays start all over a
+// map too big for the cache, so every ray brings in its own part of the map:
+// in rows a ray going north or south needs a new cache line for every tile,
+// in blocks and Z-order it needs about the same few whichever way it goes.
+bool compareLayouts(int rayCount) {
+    static const int sizes[] = { 64, 256, 1024, 4096 };
+    static const float horizontal[] = { 0, 180 };
+    static const float vertical[] = { 90, 270 };
+    static const float diagonal[] = { 45, 135, 225, 315 };
+    static const struct {
+        const char* name;
+        const float* directions;
+        int count;
+    } aims[] = { { "horizontal", horizontal, 2 }, { "vertical", vertical, 2 }, { "diagonal", diagonal, 4 } };
+    static const struct {
+        const char* name;
+        void (*cast)(Map* m, Player* ray, RayHit* hit);
+    } layoutKernels[] = { { "distfield", castRayDistFieldCells }, { "grid", castRayGridCells } };
+
+    Player* rays = malloc(rayCount * sizeof(Player));
+    RayHit* hits = malloc(rayCount * sizeof(RayHit));
+    RayHit* rowHits = malloc(rayCount * sizeof(RayHit));
+    if (rays == NULL || hits == NULL || rowHits == NULL) {
+        free(rays);
+        free(hits);
+        free(rowHits);
+        return false;
+    }
+    printf("\nlayouts, %d rays per direction from all over maps with %d%% walls (ns/ray)\n", rayCount, LAYOUT_WALLS);
+    printf("  %-10s %-11s %-12s", "map", "rays", "kernel");
+    for (int l = 0; l < GRID_LAYOUTS; l++) printf(" %8s", gridLayoutNames[l]);
+    printf("\n");
+    bool ok = true;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && ok; s++) {
+        Map m = { 0 };
+        int size = sizes[s];
+        if (!allocMap(&m, "layout", size, size)) {
+            freeMap(&m);
+            ok = false;
+            break;
+        }
+        for (int i = 0; i < size * size; i++) m.tiles[i] = nextRandom() % 100 < LAYOUT_WALLS;
+        addBorder(&m);
+        buildDistanceField(&m);
+        for (size_t a = 0; a < sizeof(aims) / sizeof(aims[0]) && ok; a++) {
+            makeAimedRays(&m, rays, rayCount, aims[a].directions, aims[a].count);
+            for (size_t k = 0; k < sizeof(layoutKernels) / sizeof(layoutKernels[0]) && ok; k++) {
+                char name[16];
+                snprintf(name, sizeof(name), "%dx%d", size, size);
+                printf("  %-10s %-11s %-12s", name, aims[a].name, layoutKernels[k].name);
+                for (int l = 0; l < GRID_LAYOUTS && ok; l++) {
+                    if (!setGridLayout(&m, l)) {
+                        ok = false;
+                        break;
+                    }
+                    double ns = timeKernel(layoutKernels[k].cast, &m, rays, l == 0 ? rowHits : hits, rayCount);
+                    // Same rays, same map, so every order must stop in the same place
+                    for (int i = 0; i < rayCount && l > 0; i++) {
+                        if (hits[i].distance != rowHits[i].distance || hits[i].mapX != rowHits[i].mapX) {
+                            printf("\n%s in %s order stopped somewhere else than in rows\n", layoutKernels[k].name,
+                                gridLayoutNames[l]);
+                            ok = false;
+                            break;
+                        }
+                    }
+                    printf(" %8.1f", ns);
+                }
+                printf("\n");
+            }
+        }
+        freeMap(&m);
+    }
+    free(rays);
+    free(hits);
+    free(rowHits);
+    return ok;
+}
+
+void runKernel(Kernel* kernel, Map* m, Player* rays, ExactHit* exact, RayHit* unitHits, RayHit* hits, int count,
+    KernelResult* result) {
+    memset(result, 0, sizeof(KernelResult));
+    result->nsPerRay = timeKernel(kernel->cast, m, rays, hits, count);
+
+    Uint64 cells = 0;
+    for (int i = 0; i < count; i++) {
+        RayHit* hit = &hits[i];
+        cells += hit->cells;
+        if (unitHits != NULL && hit->distance == unitHits[i].distance && hit->mapX == unitHits[i].mapX &&
+            (hit->mapX < 0 || (hit->mapY == unitHits[i].mapY && hit->face == unitHits[i].face))) {
+            result->sameAsUnit++;
+        }
+        // Too close to the view distance to say whether it should have stopped
+        if (exact[i].mapX < 0 || fabs(exact[i].distance - viewDistance) < 2) continue;
+        bool shouldHit = exact[i].distance < viewDistance;
+        result->compared++;
+        if (!shouldHit) {
+            if (hit->mapX >= 0) result->tileMisses++;
+            continue;
+        }
+        if (hit->mapX != exact[i].mapX || hit->mapY != exact[i].mapY) {
+            result->tileMisses++;
+            continue;
+        }
+        if (hit->face != exact[i].face) result->faceMisses++;
+        double error = fabs(hit->distance - exact[i].distance);
+        result->errorSum += error;
+        if (error > result->errorMax) result->errorMax = error;
+        if (hit->distance - exact[i].distance > 1) result->overshoots++;
+    }
+    result->cellsPerRay = (double)cells / count;
+}
+
+void printResult(Kernel* kernel, KernelResult* result, int count) {
+    int hits = result->compared - result->tileMisses;
+    printf("  %-12s %8.1f %9.1f %9.3f%% %9.3f%% %9.3f %8.3f %9.3f%% %9.1f%%   %s\n", kernel->name,
+        result->nsPerRay, result->cellsPerRay,
+        100.0 * result->tileMisses / (result->compared > 0 ? result->compared : 1),
+        100.0 * result->faceMisses / (hits > 0 ? hits : 1),
+        hits > 0 ? result->errorSum / hits : 0, result->errorMax,
+        100.0 * result->overshoots / (hits > 0 ? hits : 1),
+        100.0 * result->sameAsUnit / count, kernel->from);
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: raycast-bench [--rays n] [--seed n] [--tile-size n]
+    // For each map, times every kernel over the same rays (best of
+    // BENCH_REPEATS) and compares where each one stopped with an exact grid
+    // traversal in double precision:
+    //   ns/ray     time per ray
+    //   cells/ray  points or tiles looked at per ray
+    //   tile miss  stopped in a different tile (or not at all)
+    //   face miss  right tile, but entered through a different face
+    //   mean/max   distance error in world units, for rays that hit the right tile
+    //   overshoot  hit the right tile but stopped more than a unit inside it
+    //   same       bit for bit the same result as the legacy unit stepper
+    int rayCount = DEFAULT_RAYS;
+    Uint64 seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            rayCount = atoi(argv[++i]);
+            if (rayCount < 1 || rayCount > MAX_RAYS) {
+                printf("--rays must be between 1 and %d\n", MAX_RAYS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc) {
+            tileSize = atoi(argv[++i]);
+            if (tileSize < MIN_TILE_SIZE || tileSize > MAX_TILE_SIZE) {
+                printf("--tile-size must be between %d and %d\n", MIN_TILE_SIZE, MAX_TILE_SIZE);
+                return 1;
+            }
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            printf("Usage: %s [--rays n] [--seed n] [--tile-size n]\n", argv[0]);
+            return 1;
+        }
+    }
+    viewDistance = VIEW_DISTANCE_TILES * tileSize;
+    randomState = seed;
+
+    static Map maps[MAP_COUNT];
+    Player* rays = malloc(rayCount * sizeof(Player));
+    ExactHit* exact = malloc(rayCount * sizeof(ExactHit));
+    RayHit* unitHits = malloc(rayCount * sizeof(RayHit));
+    RayHit* hits = malloc(rayCount * sizeof(RayHit));
+    if (!makeMaps(maps) || rays == NULL || exact == NULL || unitHits == NULL || hits == NULL) {
+        printf("Not enough memory for %d rays\n", rayCount);
+        return 1;
+    }
+
+    printf("%d rays per map, tile size %d, view distance %d\n", rayCount, tileSize, viewDistance);
+    for (int i = 0; i < MAP_COUNT; i++) {
+        Map* m = &maps[i];
+        makeRays(m, rays, rayCount);
+        for (int j = 0; j < rayCount; j++) {
+            traceExact(m, &rays[j], &exact[j]);
+        }
+        printf("\nmap %s (%dx%d)\n", m->name, m->width, m->height);
+        printf("  %-12s %8s %9s %10s %10s %9s %8s %10s %10s\n", "kernel", "ns/ray", "cells/ray",
+            "tile miss", "face miss", "mean err", "max err", "overshoot", "same");
+        for (int k = 0; k < KERNEL_COUNT; k++) {
+            if (kernels[k].onlyDefaultTile && tileSize != DEFAULT_TILE_SIZE) continue;
+            KernelResult result;
+            runKernel(&kernels[k], m, rays, exact, k == 0 ? NULL : unitHits, k == 0 ? unitHits : hits, rayCount, &result);
+            if (k == 0) result.sameAsUnit = rayCount;
+            printResult(&kernels[k], &result, rayCount);
+        }
+    }
+    if (!compareLayouts(rayCount < LAYOUT_RAYS ? rayCount : LAYOUT_RAYS)) {
+        return 1;
+    }
+
+    for (int i = 0; i < MAP_COUNT; i++) {
+        freeMap(&maps[i]);
+    }
+    free(rays);
+    free(exact);
+    free(unitHits);
+    free(hits);
+    return 0;
+}
@@ -0,0 +1,632 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define FOV 60
+#define NUM_RAYS SCREEN_WIDTH
+#define TILE_SIZE 64
+#define MAP_WIDTH 10   // Size of the built-in map used when no map file is given
+#define MAP_HEIGHT 8
+#define WALL_HEIGHT 4000  // Set wall height to 4000 for taller walls
+
+#define MAX_MAP_SIDE 65536  // Largest map width/height a map file may declare
+#define MAX_DIST_FIELD 255  // Distance field values are stored in one byte
+
+// Map file format (.rcm), all numbers little-endian:
+//   header:  "RCMP", u16 version, u16 layer count, u32 width, u32 height,
+//            u32 CRC32 of everything after the header
+//   layers:  u8 type, u8 encoding, u16 reserved, u32 encoded size, data
+// Every layer holds width * height bytes once decoded. Unknown layer types are
+// skipped so newer files still open in older versions.
+#define MAP_MAGIC "RCMP"
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 20
+#define LAYER_HEADER_SIZE 8
+#define LAYER_TILES 1
+#define LAYER_DIST_FIELD 2  // Precomputed so loading doesn't have to rebuild it
+#define ENCODING_RAW 0
+#define ENCODING_RLE 1
+
+typedef struct {
+    float x, y;
+    float angle;
+} Player;
+
+typedef struct {
+    int width, height;
+    Uint8* tiles;      // width * height tiles, row-major, 1 is a wall
+    Uint8* distField;  // Distance in tiles to the nearest wall (8-neighbour), 0 on walls
+} Map;
+
+// Simple 2D map where 1 represents a wall and 0 is empty space
+int defaultMap[MAP_HEIGHT][MAP_WIDTH] = {
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 1, 0, 0, 1},
+    {1, 0, 0, 0, 0, 1, 1, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
+
+Map map;
+
+int getTile(int x, int y) {
+    return map.tiles[y * map.width + x];
+}
+
+// Rebuild the distance field with a two-pass chamfer sweep. Every step costs 1,
+// so the result is the exact Chebyshev distance to the nearest wall tile.
+void buildDistanceField(Map* m) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = w - 1; x >= 0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+void setTile(int x, int y, int value) {
+    map.tiles[y * map.width + x] = value;
+    buildDistanceField(&map);
+}
+
+bool allocMap(Map* m, int width, int height) {
+    m->width = width;
+    m->height = height;
+    m->tiles = malloc((size_t)width * height);
+    m->distField = malloc((size_t)width * height);
+    if (m->tiles == NULL || m->distField == NULL) {
+        free(m->tiles);
+        free(m->distField);
+        m->tiles = m->distField = NULL;
+        return false;
+    }
+    return true;
+}
+
+void freeMap(Map* m) {
+    free(m->tiles);
+    free(m->distField);
+    m->tiles = m->distField = NULL;
+}
+
+void loadDefaultMap(Map* m) {
+    allocMap(m, MAP_WIDTH, MAP_HEIGHT);
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            m->tiles[y * MAP_WIDTH + x] = defaultMap[y][x];
+        }
+    }
+    buildDistanceField(m);
+}
+
+Uint32 crcTable[256];
+
+Uint32 crc32(const Uint8* data, size_t size) {
+    if (crcTable[1] == 0) {
+        for (Uint32 i = 0; i < 256; i++) {
+            Uint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crcTable[i] = c;
+        }
+    }
+    Uint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+Uint32 readU32(const Uint8* p) {
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+Uint16 readU16(const Uint8* p) {
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+void writeU32(Uint8* p, Uint32 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void writeU16(Uint8* p, Uint16 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+// Run-length encoding in PackBits style: a control byte c < 128 is followed by
+// c + 1 literal bytes, a control byte c >= 128 repeats the next byte c - 126 times.
+// Literals cost a control byte per 128, so alternating data grows by up to a
+// third; encoding stops and returns capacity once the output would not fit.
+size_t rleEncode(const Uint8* src, size_t size, Uint8* dst, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        size_t run = 1;
+        while (in + run < size && run < 129 && src[in + run] == src[in]) run++;
+        if (run >= 2) {
+            if (out + 2 > capacity) return capacity;
+            dst[out++] = (Uint8)(run + 126);
+            dst[out++] = src[in];
+            in += run;
+        } else {
+            size_t start = in;
+            size_t count = 0;
+            while (in < size && count < 128 && !(in + 1 < size && src[in + 1] == src[in])) {
+                in++;
+                count++;
+            }
+            if (out + 1 + count > capacity) return capacity;
+            dst[out++] = (Uint8)(count - 1);
+            memcpy(dst + out, src + start, count);
+            out += count;
+        }
+    }
+    return out;
+}
+
+// Decode straight into the destination layer; fails on any overrun or short data
+bool rleDecode(const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        Uint8 c = src[in++];
+        if (c < 128) {
+            size_t count = c + 1;
+            if (in + count > size || out + count > dstSize) return false;
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+        } else {
+            size_t count = c - 126;
+            if (in >= size || out + count > dstSize) return false;
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+    return out == dstSize;
+}
+
+bool decodeLayer(int encoding, const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    if (encoding == ENCODING_RAW) {
+        if (size != dstSize) return false;
+        memcpy(dst, src, size);
+        return true;
+    }
+    if (encoding == ENCODING_RLE) {
+        return rleDecode(src, size, dst, dstSize);
+    }
+    return false;
+}
+
+// Load a map file. The whole file is read with a single fread, checked, and then
+// every layer is decoded directly into the freshly allocated map.
+bool loadMapFile(const char* path, Map* out) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open map file %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (fileSize < MAP_HEADER_SIZE) {
+        printf("Map file %s is too small\n", path);
+        fclose(file);
+        return false;
+    }
+
+    Uint8* data = malloc(fileSize);
+    if (data == NULL || fread(data, 1, fileSize, file) != (size_t)fileSize) {
+        printf("Could not read map file %s\n", path);
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    Uint16 version = readU16(data + 4);
+    int layerCount = readU16(data + 6);
+    Uint32 width = readU32(data + 8);
+    Uint32 height = readU32(data + 12);
+    Uint32 checksum = readU32(data + 16);
+    if (memcmp(data, MAP_MAGIC, 4) != 0 || version != MAP_VERSION) {
+        printf("%s is not a version %d map file\n", path, MAP_VERSION);
+        free(data);
+        return false;
+    }
+    if (width == 0 || height == 0 || width > MAX_MAP_SIDE || height > MAX_MAP_SIDE) {
+        printf("Map file %s has bad dimensions %ux%u\n", path, width, height);
+        free(data);
+        return false;
+    }
+    if (crc32(data + MAP_HEADER_SIZE, fileSize - MAP_HEADER_SIZE) != checksum) {
+        printf("Map file %s failed its checksum\n", path);
+        free(data);
+        return false;
+    }
+
+    Map m;
+    if (!allocMap(&m, width, height)) {
+        printf("Not enough memory for a %ux%u map\n", width, height);
+        free(data);
+        return false;
+    }
+
+    size_t layerSize = (size_t)width * height;
+    size_t pos = MAP_HEADER_SIZE;
+    bool haveTiles = false;
+    bool haveDistField = false;
+    for (int i = 0; i < layerCount; i++) {
+        if (pos + LAYER_HEADER_SIZE > (size_t)fileSize) break;
+        int type = data[pos];
+        int encoding = data[pos + 1];
+        size_t size = readU32(data + pos + 4);
+        pos += LAYER_HEADER_SIZE;
+        if (size > (size_t)fileSize - pos) break;
+
+        Uint8* dst = NULL;
+        if (type == LAYER_TILES) dst = m.tiles;
+        if (type == LAYER_DIST_FIELD) dst = m.distField;
+        if (dst != NULL) {
+            if (!decodeLayer(encoding, data + pos, size, dst, layerSize)) {
+                printf("Map file %s has a corrupt layer %d\n", path, type);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            if (type == LAYER_TILES) haveTiles = true;
+            if (type == LAYER_DIST_FIELD) haveDistField = true;
+        }
+        pos += size;
+    }
+    free(data);
+
+    if (!haveTiles) {
+        printf("Map file %s has no tile layer\n", path);
+        freeMap(&m);
+        return false;
+    }
+    if (!haveDistField) {
+        buildDistanceField(&m);
+    }
+    *out = m;
+    return true;
+}
+
+// Append one RLE layer at pos, falling back to raw storage if RLE doesn't help
+size_t writeLayer(Uint8* dst, int type, const Uint8* src, size_t size) {
+    size_t encoded = rleEncode(src, size, dst + LAYER_HEADER_SIZE, size);
+    int encoding = ENCODING_RLE;
+    if (encoded >= size) {
+        memcpy(dst + LAYER_HEADER_SIZE, src, size);
+        encoded = size;
+        encoding = ENCODING_RAW;
+    }
+    dst[0] = type;
+    dst[1] = encoding;
+    writeU16(dst + 2, 0);
+    writeU32(dst + 4, encoded);
+    return LAYER_HEADER_SIZE + encoded;
+}
+
+bool saveMapFile(const char* path, Map* m) {
+    size_t layerSize = (size_t)m->width * m->height;
+    // writeLayer never stores more than the raw layer
+    size_t maxLayer = LAYER_HEADER_SIZE + layerSize;
+    Uint8* data = malloc(MAP_HEADER_SIZE + 2 * maxLayer);
+    if (data == NULL) {
+        printf("Not enough memory to save %s\n", path);
+        return false;
+    }
+
+    size_t pos = MAP_HEADER_SIZE;
+    pos += writeLayer(data + pos, LAYER_TILES, m->tiles, layerSize);
+    pos += writeLayer(data + pos, LAYER_DIST_FIELD, m->distField, layerSize);
+
+    memcpy(data, MAP_MAGIC, 4);
+    writeU16(data + 4, MAP_VERSION);
+    writeU16(data + 6, 2);
+    writeU32(data + 8, m->width);
+    writeU32(data + 12, m->height);
+    writeU32(data + 16, crc32(data + MAP_HEADER_SIZE, pos - MAP_HEADER_SIZE));
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, pos, file) == pos;
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(data);
+    if (!ok) {
+        printf("Could not write map file %s\n", path);
+    }
+    return ok;
+}
+
+// Function to check for wall collision
+bool isWall(int x, int y) {
+    int mapX = x / TILE_SIZE;
+    int mapY = y / TILE_SIZE;
+    if (mapX >= 0 && mapX < map.width && mapY >= 0 && mapY < map.height) {
+        return getTile(mapX, mapY) == 1;
+    }
+    return false;
+}
+
+// Check if the player can move to the new position
+bool canMoveTo(Player* player, float deltaX, float deltaY) {
+    float newX = player->x + deltaX;
+    float newY = player->y + deltaY;
+    return !isWall(newX, newY);
+}
+
+float castRay(Player* player, float rayAngle) {
+    float rayX = player->x;
+    float rayY = player->y;
+    float stepX = cos(rayAngle * M_PI / 180);
+    float stepY = sin(rayAngle * M_PI / 180);
+    float distance = 0;
+
+    while (!isWall(rayX, rayY) && distance < SCREEN_WIDTH) {
+        // A wall at least d tiles away (in both axes) leaves d - 1 whole tiles
+        // of open space, so the ray can jump across them in one step
+        int step = 1;
+        int mapX = (int)rayX / TILE_SIZE;
+        int mapY = (int)rayY / TILE_SIZE;
+        if (rayX >= 0 && rayY >= 0 && mapX < map.width && mapY < map.height) {
+            int d = map.distField[mapY * map.width + mapX];
+            if (d > 1) {
+                step = (d - 1) * TILE_SIZE;
+                if (distance + step > SCREEN_WIDTH) step = SCREEN_WIDTH - distance;
+                if (step < 1) step = 1;
+            }
+        }
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+    }
+
+    return distance;
+}
+
+void render3DView(SDL_Renderer* renderer, Player* player) {
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float distance = castRay(player, rayAngle);
+
+        float wallHeight = WALL_HEIGHT / (distance * cos((rayAngle - player->angle) * M_PI / 180));
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+
+        // Render ceiling (roof)
+        SDL_SetRenderDrawColor(renderer, 50, 50, 100, 255);
+        SDL_RenderDrawLine(renderer, i, 0, i, wallTop);
+
+        // Render wall
+        SDL_SetRenderDrawColor(renderer, shade, shade, shade, 255);
+        SDL_RenderDrawLine(renderer, i, wallTop, i, wallBottom);
+
+        // Render floor
+        SDL_SetRenderDrawColor(renderer, 100, 50, 50, 255);
+        SDL_RenderDrawLine(renderer, i, wallBottom, i, SCREEN_HEIGHT);
+    }
+
+    // Render the player
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for player
+    SDL_Rect playerRect = { (int)(player->x - 5), (int)(player->y - 5), 10, 10 };
+    SDL_RenderFillRect(renderer, &playerRect);
+
+    // Render rays
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255); // Yellow for rays
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float distance = castRay(player, rayAngle);
+        float rayX = player->x + cos(rayAngle * M_PI / 180) * distance;
+        float rayY = player->y + sin(rayAngle * M_PI / 180) * distance;
+        SDL_RenderDrawLine(renderer, player->x, player->y, rayX, rayY);
+    }
+}
+
+void renderMap(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) == 1) {
+                SDL_Rect wallRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                SDL_RenderFillRect(renderer, &wallRect);
+            }
+        }
+    }
+}
+
+void renderMapEditor(SDL_Renderer* renderer) {
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            SDL_Rect tileRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+            if (getTile(x, y) == 1) {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Wall (1) - Red
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Empty (0) - White
+            }
+            SDL_RenderFillRect(renderer, &tileRect);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black border
+            SDL_RenderDrawRect(renderer, &tileRect);
+        }
+    }
+}
+
+// Move the player to the first open tile if the start position is inside a wall
+void placePlayer(Player* player) {
+    if (!isWall(player->x, player->y)) return;
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) != 1) {
+                player->x = x * TILE_SIZE + TILE_SIZE / 2;
+                player->y = y * TILE_SIZE + TILE_SIZE / 2;
+                return;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: raycastv-4.03 [map.rcm]
+    // F2 saves the (edited) map to the same file, or to map.rcm by default.
+    const char* mapPath = "map.rcm";
+    if (argc > 1) {
+        mapPath = argv[1];
+        if (!loadMapFile(mapPath, &map)) {
+            return 1;
+        }
+    } else {
+        loadDefaultMap(&map);
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Create main game window
+    SDL_Window* mainWindow = SDL_CreateWindow("Raycasting Game",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    // Create 3D view window
+    SDL_Window* viewWindow = SDL_CreateWindow("3D View",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* viewRenderer = SDL_CreateRenderer(viewWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    // Create map editor window
+    SDL_Window* editorWindow = SDL_CreateWindow("Map Editor",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, map.width * TILE_SIZE, map.height * TILE_SIZE, SDL_WINDOW_SHOWN);
+    SDL_Renderer* editorRenderer = SDL_CreateRenderer(editorWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+    placePlayer(&player);
+
+    bool quit = false;
+    const Uint8* keystate;
+    SDL_Event e;
+
+    while (!quit) {
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            // Save the map
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2) {
+                if (saveMapFile(mapPath, &map)) {
+                    printf("Saved map to %s\n", mapPath);
+                }
+            }
+            // Map editor mouse click handling
+            if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+                int gridX = mouseX / TILE_SIZE;
+                int gridY = mouseY / TILE_SIZE;
+                if (gridX >= 0 && gridX < map.width && gridY >= 0 && gridY < map.height) {
+                    // Toggle between wall (1) and empty (0)
+                    setTile(gridX, gridY, (getTile(gridX, gridY) == 1) ? 0 : 1);
+                }
+            }
+        }
+
+        keystate = SDL_GetKeyboardState(NULL);
+
+        // Handle player movement
+        float speed = 2.0f;
+        if (keystate[SDL_SCANCODE_W]) {
+            float deltaX = cos(player.angle * M_PI / 180) * speed;
+            float deltaY = sin(player.angle * M_PI / 180) * speed;
+            if (canMoveTo(&player, deltaX, deltaY)) {
+                player.x += deltaX;
+                player.y += deltaY;
+            }
+        }
+        if (keystate[SDL_SCANCODE_S]) {
+            float deltaX = -cos(player.angle * M_PI / 180) * speed;
+            float deltaY = -sin(player.angle * M_PI / 180) * speed;
+            if (canMoveTo(&player, deltaX, deltaY)) {
+                player.x += deltaX;
+                player.y += deltaY;
+            }
+        }
+        if (keystate[SDL_SCANCODE_A]) {
+            player.angle -= 2.0f; // Rotate left
+        }
+        if (keystate[SDL_SCANCODE_D]) {
+            player.angle += 2.0f; // Rotate right
+        }
+
+        // Render the 3D view
+        SDL_SetRenderDrawColor(viewRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(viewRenderer);
+        render3DView(viewRenderer, &player);
+        SDL_RenderPresent(viewRenderer);
+
+        // Render the main game window
+        SDL_SetRenderDrawColor(mainRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(mainRenderer);
+        renderMap(mainRenderer);
+        SDL_RenderPresent(mainRenderer);
+
+        // Render the map editor
+        SDL_SetRenderDrawColor(editorRenderer, 255, 255, 255, 255);
+        SDL_RenderClear(editorRenderer);
+        renderMapEditor(editorRenderer);
+        SDL_RenderPresent(editorRenderer);
+    }
+
+    SDL_DestroyRenderer(mainRenderer);
+    SDL_DestroyWindow(mainWindow);
+    SDL_DestroyRenderer(viewRenderer);
+    SDL_DestroyWindow(viewWindow);
+    SDL_DestroyRenderer(editorRenderer);
+    SDL_DestroyWindow(editorWindow);
+    SDL_Quit();
+    freeMap(&map);
+
+    return 0;
+}
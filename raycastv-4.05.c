@@ -0,0 +1,1260 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define FOV 60
+#define NUM_RAYS SCREEN_WIDTH
+#define TILE_SIZE 64
+#define MAP_WIDTH 10   // Size of the built-in map used when no map file is given
+#define MAP_HEIGHT 8
+#define WALL_HEIGHT 4000  // Set wall height to 4000 for taller walls
+
+#define MAX_MAP_SIDE 65536  // Largest map width/height a map file may declare
+#define MAX_DIST_FIELD 255  // Distance field values are stored in one byte
+
+// Map file format (.rcm), all numbers little-endian:
+//   header:  "RCMP", u16 version, u16 layer count, u32 width, u32 height,
+//            u32 CRC32 of everything after the header
+//   layers:  u8 type, u8 encoding, u16 reserved, u32 encoded size, data
+// Every layer holds width * height bytes once decoded. Unknown layer types are
+// skipped so newer files still open in older versions.
+#define MAP_MAGIC "RCMP"
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 20
+#define LAYER_HEADER_SIZE 8
+#define LAYER_TILES 1
+#define LAYER_DIST_FIELD 2  // Precomputed so loading doesn't have to rebuild it
+#define ENCODING_RAW 0
+#define ENCODING_RLE 1
+
+// Input recording format (.rcr), little-endian:
+//   header:  "RCRP", u16 version, u16 reserved, u32 CRC32 of the map tiles,
+//            f32 start x, f32 start y, f32 start angle
+//   records: u8 buttons, u8 tick count, and when RECORD_HAS_EDITS is set,
+//            u8 edit count followed by u16 x, u16 y per toggled tile
+// Ticks without edits are run-length merged, so holding a key costs 2 bytes
+// per 255 ticks.
+#define RECORD_MAGIC "RCRP"
+#define RECORD_VERSION 1
+#define RECORD_HEADER_SIZE 24
+#define RECORD_HAS_EDITS 0x80
+
+#define INPUT_FORWARD 1
+#define INPUT_BACK 2
+#define INPUT_LEFT 4
+#define INPUT_RIGHT 8
+#define MAX_TICK_EDITS 32
+
+// Offscreen export: frames are rendered into a ring of preallocated surfaces and
+// a writer thread converts and writes them while the next frame renders
+#define EXPORT_RING_SIZE 4
+#define EXPORT_FPS 60
+#define MAX_PATH_KEYS 1024
+
+typedef struct {
+    float x, y;
+    float angle;
+} Player;
+
+typedef struct {
+    int width, height;
+    Uint8* tiles;      // width * height tiles, row-major, 1 is a wall
+    Uint8* distField;  // Distance in tiles to the nearest wall (8-neighbour), 0 on walls
+    Uint64 hash;       // Hash of all tiles, updated by setTile on every edit
+} Map;
+
+// Simple 2D map where 1 represents a wall and 0 is empty space
+int defaultMap[MAP_HEIGHT][MAP_WIDTH] = {
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 1, 0, 0, 1},
+    {1, 0, 0, 0, 0, 1, 1, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
+
+typedef struct {
+    Uint16 x, y;
+} TileEdit;
+
+// Everything the simulation reads from the user during one tick
+typedef struct {
+    Uint8 buttons;
+    int editCount;
+    TileEdit edits[MAX_TICK_EDITS];
+} TickInput;
+
+typedef struct {
+    FILE* file;
+    Uint8 buttons;  // Pending run of edit-free ticks
+    int runLength;
+} InputRecorder;
+
+typedef struct {
+    Uint8* data;
+    size_t size;
+    size_t pos;
+    Uint8 buttons;  // Current run being played back
+    int runLeft;
+} InputReplay;
+
+// One camera path keyframe; poses in between are interpolated linearly
+typedef struct {
+    int frame;
+    Player pose;
+} PathKey;
+
+typedef struct {
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;
+    bool last;  // Set on the final frame so the writer knows to stop
+    bool empty; // No frame in it, only there to stop the writer
+} ExportSlot;
+
+typedef struct {
+    FILE* file;
+    bool y4m;            // YUV4MPEG2 4:2:0, otherwise a sequence of binary PPMs
+    Uint8* convertBuffer;
+    ExportSlot slots[EXPORT_RING_SIZE];
+    SDL_sem* freeSlots;
+    SDL_sem* fullSlots;
+    SDL_Thread* writer;
+    bool failed;
+} VideoExport;
+
+Map map;
+
+int getTile(int x, int y) {
+    return map.tiles[y * map.width + x];
+}
+
+Uint64 mixHash(Uint64 v) {
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+}
+
+// Per-tile terms are XORed together so a single edit can be patched in O(1)
+Uint64 tileHash(size_t index, int value) {
+    return value == 0 ? 0 : mixHash(((Uint64)index << 8) | value);
+}
+
+Uint64 hashTiles(Map* m) {
+    Uint64 hash = 0;
+    size_t count = (size_t)m->width * m->height;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= tileHash(i, m->tiles[i]);
+    }
+    return hash;
+}
+
+// Rebuild the distance field with a two-pass chamfer sweep. Every step costs 1,
+// so the result is the exact Chebyshev distance to the nearest wall tile.
+void buildDistanceField(Map* m) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = w - 1; x >= 0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+void setTile(int x, int y, int value) {
+    size_t index = (size_t)y * map.width + x;
+    map.hash ^= tileHash(index, map.tiles[index]) ^ tileHash(index, value);
+    map.tiles[index] = value;
+    buildDistanceField(&map);
+}
+
+bool allocMap(Map* m, int width, int height) {
+    m->width = width;
+    m->height = height;
+    m->tiles = malloc((size_t)width * height);
+    m->distField = malloc((size_t)width * height);
+    if (m->tiles == NULL || m->distField == NULL) {
+        free(m->tiles);
+        free(m->distField);
+        m->tiles = m->distField = NULL;
+        return false;
+    }
+    return true;
+}
+
+void freeMap(Map* m) {
+    free(m->tiles);
+    free(m->distField);
+    m->tiles = m->distField = NULL;
+}
+
+void loadDefaultMap(Map* m) {
+    allocMap(m, MAP_WIDTH, MAP_HEIGHT);
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            m->tiles[y * MAP_WIDTH + x] = defaultMap[y][x];
+        }
+    }
+    buildDistanceField(m);
+    m->hash = hashTiles(m);
+}
+
+Uint32 crcTable[256];
+
+Uint32 crc32(const Uint8* data, size_t size) {
+    if (crcTable[1] == 0) {
+        for (Uint32 i = 0; i < 256; i++) {
+            Uint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crcTable[i] = c;
+        }
+    }
+    Uint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+Uint32 readU32(const Uint8* p) {
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+Uint16 readU16(const Uint8* p) {
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+void writeU32(Uint8* p, Uint32 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void writeU16(Uint8* p, Uint16 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+// Run-length encoding in PackBits style: a control byte c < 128 is followed by
+// c + 1 literal bytes, a control byte c >= 128 repeats the next byte c - 126 times.
+// Literals cost a control byte per 128, so alternating data grows by up to a
+// third; encoding stops and returns capacity once the output would not fit.
+size_t rleEncode(const Uint8* src, size_t size, Uint8* dst, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        size_t run = 1;
+        while (in + run < size && run < 129 && src[in + run] == src[in]) run++;
+        if (run >= 2) {
+            if (out + 2 > capacity) return capacity;
+            dst[out++] = (Uint8)(run + 126);
+            dst[out++] = src[in];
+            in += run;
+        } else {
+            size_t start = in;
+            size_t count = 0;
+            while (in < size && count < 128 && !(in + 1 < size && src[in + 1] == src[in])) {
+                in++;
+                count++;
+            }
+            if (out + 1 + count > capacity) return capacity;
+            dst[out++] = (Uint8)(count - 1);
+            memcpy(dst + out, src + start, count);
+            out += count;
+        }
+    }
+    return out;
+}
+
+// Decode straight into the destination layer; fails on any overrun or short data
+bool rleDecode(const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        Uint8 c = src[in++];
+        if (c < 128) {
+            size_t count = c + 1;
+            if (in + count > size || out + count > dstSize) return false;
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+        } else {
+            size_t count = c - 126;
+            if (in >= size || out + count > dstSize) return false;
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+    return out == dstSize;
+}
+
+bool decodeLayer(int encoding, const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    if (encoding == ENCODING_RAW) {
+        if (size != dstSize) return false;
+        memcpy(dst, src, size);
+        return true;
+    }
+    if (encoding == ENCODING_RLE) {
+        return rleDecode(src, size, dst, dstSize);
+    }
+    return false;
+}
+
+// Load a map file. The whole file is read with a single fread, checked, and then
+// every layer is decoded directly into the freshly allocated map.
+bool loadMapFile(const char* path, Map* out) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open map file %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (fileSize < MAP_HEADER_SIZE) {
+        printf("Map file %s is too small\n", path);
+        fclose(file);
+        return false;
+    }
+
+    Uint8* data = malloc(fileSize);
+    if (data == NULL || fread(data, 1, fileSize, file) != (size_t)fileSize) {
+        printf("Could not read map file %s\n", path);
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    Uint16 version = readU16(data + 4);
+    int layerCount = readU16(data + 6);
+    Uint32 width = readU32(data + 8);
+    Uint32 height = readU32(data + 12);
+    Uint32 checksum = readU32(data + 16);
+    if (memcmp(data, MAP_MAGIC, 4) != 0 || version != MAP_VERSION) {
+        printf("%s is not a version %d map file\n", path, MAP_VERSION);
+        free(data);
+        return false;
+    }
+    if (width == 0 || height == 0 || width > MAX_MAP_SIDE || height > MAX_MAP_SIDE) {
+        printf("Map file %s has bad dimensions %ux%u\n", path, width, height);
+        free(data);
+        return false;
+    }
+    if (crc32(data + MAP_HEADER_SIZE, fileSize - MAP_HEADER_SIZE) != checksum) {
+        printf("Map file %s failed its checksum\n", path);
+        free(data);
+        return false;
+    }
+
+    Map m;
+    if (!allocMap(&m, width, height)) {
+        printf("Not enough memory for a %ux%u map\n", width, height);
+        free(data);
+        return false;
+    }
+
+    size_t layerSize = (size_t)width * height;
+    size_t pos = MAP_HEADER_SIZE;
+    bool haveTiles = false;
+    bool haveDistField = false;
+    for (int i = 0; i < layerCount; i++) {
+        if (pos + LAYER_HEADER_SIZE > (size_t)fileSize) break;
+        int type = data[pos];
+        int encoding = data[pos + 1];
+        size_t size = readU32(data + pos + 4);
+        pos += LAYER_HEADER_SIZE;
+        if (size > (size_t)fileSize - pos) break;
+
+        Uint8* dst = NULL;
+        if (type == LAYER_TILES) dst = m.tiles;
+        if (type == LAYER_DIST_FIELD) dst = m.distField;
+        if (dst != NULL) {
+            if (!decodeLayer(encoding, data + pos, size, dst, layerSize)) {
+                printf("Map file %s has a corrupt layer %d\n", path, type);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            if (type == LAYER_TILES) haveTiles = true;
+            if (type == LAYER_DIST_FIELD) haveDistField = true;
+        }
+        pos += size;
+    }
+    free(data);
+
+    if (!haveTiles) {
+        printf("Map file %s has no tile layer\n", path);
+        freeMap(&m);
+        return false;
+    }
+    if (!haveDistField) {
+        buildDistanceField(&m);
+    }
+    m.hash = hashTiles(&m);
+    *out = m;
+    return true;
+}
+
+// Append one RLE layer at pos, falling back to raw storage if RLE doesn't help
+size_t writeLayer(Uint8* dst, int type, const Uint8* src, size_t size) {
+    size_t encoded = rleEncode(src, size, dst + LAYER_HEADER_SIZE, size);
+    int encoding = ENCODING_RLE;
+    if (encoded >= size) {
+        memcpy(dst + LAYER_HEADER_SIZE, src, size);
+        encoded = size;
+        encoding = ENCODING_RAW;
+    }
+    dst[0] = type;
+    dst[1] = encoding;
+    writeU16(dst + 2, 0);
+    writeU32(dst + 4, encoded);
+    return LAYER_HEADER_SIZE + encoded;
+}
+
+bool saveMapFile(const char* path, Map* m) {
+    size_t layerSize = (size_t)m->width * m->height;
+    // writeLayer never stores more than the raw layer
+    size_t maxLayer = LAYER_HEADER_SIZE + layerSize;
+    Uint8* data = malloc(MAP_HEADER_SIZE + 2 * maxLayer);
+    if (data == NULL) {
+        printf("Not enough memory to save %s\n", path);
+        return false;
+    }
+
+    size_t pos = MAP_HEADER_SIZE;
+    pos += writeLayer(data + pos, LAYER_TILES, m->tiles, layerSize);
+    pos += writeLayer(data + pos, LAYER_DIST_FIELD, m->distField, layerSize);
+
+    memcpy(data, MAP_MAGIC, 4);
+    writeU16(data + 4, MAP_VERSION);
+    writeU16(data + 6, 2);
+    writeU32(data + 8, m->width);
+    writeU32(data + 12, m->height);
+    writeU32(data + 16, crc32(data + MAP_HEADER_SIZE, pos - MAP_HEADER_SIZE));
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, pos, file) == pos;
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(data);
+    if (!ok) {
+        printf("Could not write map file %s\n", path);
+    }
+    return ok;
+}
+
+// Function to check for wall collision
+bool isWall(int x, int y) {
+    int mapX = x / TILE_SIZE;
+    int mapY = y / TILE_SIZE;
+    if (mapX >= 0 && mapX < map.width && mapY >= 0 && mapY < map.height) {
+        return getTile(mapX, mapY) == 1;
+    }
+    return false;
+}
+
+// Check if the player can move to the new position
+bool canMoveTo(Player* player, float deltaX, float deltaY) {
+    float newX = player->x + deltaX;
+    float newY = player->y + deltaY;
+    return !isWall(newX, newY);
+}
+
+// Advance the game by one tick. This is the only place input changes the world,
+// so feeding it the same TickInputs always produces the same game.
+void simulateTick(Player* player, TickInput* input) {
+    for (int i = 0; i < input->editCount; i++) {
+        int gridX = input->edits[i].x;
+        int gridY = input->edits[i].y;
+        if (gridX < map.width && gridY < map.height) {
+            // Toggle between wall (1) and empty (0)
+            setTile(gridX, gridY, (getTile(gridX, gridY) == 1) ? 0 : 1);
+        }
+    }
+
+    // Handle player movement
+    float speed = 2.0f;
+    if (input->buttons & INPUT_FORWARD) {
+        float deltaX = cos(player->angle * M_PI / 180) * speed;
+        float deltaY = sin(player->angle * M_PI / 180) * speed;
+        if (canMoveTo(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_BACK) {
+        float deltaX = -cos(player->angle * M_PI / 180) * speed;
+        float deltaY = -sin(player->angle * M_PI / 180) * speed;
+        if (canMoveTo(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_LEFT) {
+        player->angle -= 2.0f; // Rotate left
+    }
+    if (input->buttons & INPUT_RIGHT) {
+        player->angle += 2.0f; // Rotate right
+    }
+}
+
+// Hash of everything the simulation owns, compared between runs to prove that
+// a change didn't alter behaviour
+Uint64 stateHash(Player* player) {
+    Uint32 bits[3];
+    memcpy(&bits[0], &player->x, 4);
+    memcpy(&bits[1], &player->y, 4);
+    memcpy(&bits[2], &player->angle, 4);
+    Uint64 hash = map.hash;
+    for (int i = 0; i < 3; i++) {
+        hash = mixHash(hash ^ bits[i]);
+    }
+    return hash;
+}
+
+Uint32 readF32Bits(const Uint8* p, float* value) {
+    Uint32 bits = readU32(p);
+    memcpy(value, &bits, 4);
+    return bits;
+}
+
+void writeF32(Uint8* p, float value) {
+    Uint32 bits;
+    memcpy(&bits, &value, 4);
+    writeU32(p, bits);
+}
+
+bool startRecording(InputRecorder* rec, const char* path, Player* player) {
+    rec->file = fopen(path, "wb");
+    rec->runLength = 0;
+    if (rec->file == NULL) {
+        printf("Could not create recording %s\n", path);
+        return false;
+    }
+    Uint8 header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, 4);
+    writeU16(header + 4, RECORD_VERSION);
+    writeU16(header + 6, 0);
+    writeU32(header + 8, crc32(map.tiles, (size_t)map.width * map.height));
+    writeF32(header + 12, player->x);
+    writeF32(header + 16, player->y);
+    writeF32(header + 20, player->angle);
+    fwrite(header, 1, RECORD_HEADER_SIZE, rec->file);
+    return true;
+}
+
+void flushRecordRun(InputRecorder* rec) {
+    if (rec->runLength > 0) {
+        Uint8 record[2] = { rec->buttons, (Uint8)rec->runLength };
+        fwrite(record, 1, 2, rec->file);
+        rec->runLength = 0;
+    }
+}
+
+void recordTick(InputRecorder* rec, TickInput* input) {
+    if (input->editCount == 0) {
+        if (rec->runLength > 0 && (rec->buttons != input->buttons || rec->runLength == 255)) {
+            flushRecordRun(rec);
+        }
+        rec->buttons = input->buttons;
+        rec->runLength++;
+        return;
+    }
+
+    flushRecordRun(rec);
+    Uint8 record[3 + MAX_TICK_EDITS * 4];
+    record[0] = input->buttons | RECORD_HAS_EDITS;
+    record[1] = 1;
+    record[2] = input->editCount;
+    for (int i = 0; i < input->editCount; i++) {
+        writeU16(record + 3 + i * 4, input->edits[i].x);
+        writeU16(record + 5 + i * 4, input->edits[i].y);
+    }
+    fwrite(record, 1, 3 + input->editCount * 4, rec->file);
+}
+
+void stopRecording(InputRecorder* rec) {
+    flushRecordRun(rec);
+    fclose(rec->file);
+    rec->file = NULL;
+}
+
+bool openReplay(InputReplay* replay, const char* path, Player* player) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open recording %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    replay->data = size > 0 ? malloc(size) : NULL;
+    if (replay->data == NULL || fread(replay->data, 1, size, file) != (size_t)size) {
+        printf("Could not read recording %s\n", path);
+        free(replay->data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    if (size < RECORD_HEADER_SIZE || memcmp(replay->data, RECORD_MAGIC, 4) != 0 || readU16(replay->data + 4) != RECORD_VERSION) {
+        printf("%s is not a version %d recording\n", path, RECORD_VERSION);
+        free(replay->data);
+        return false;
+    }
+    if (readU32(replay->data + 8) != crc32(map.tiles, (size_t)map.width * map.height)) {
+        printf("Warning: %s was recorded on a different map\n", path);
+    }
+    readF32Bits(replay->data + 12, &player->x);
+    readF32Bits(replay->data + 16, &player->y);
+    readF32Bits(replay->data + 20, &player->angle);
+    replay->size = size;
+    replay->pos = RECORD_HEADER_SIZE;
+    replay->runLeft = 0;
+    return true;
+}
+
+// Fill in the next tick from the recording; returns false once it runs out
+bool replayTick(InputReplay* replay, TickInput* input) {
+    input->editCount = 0;
+    if (replay->runLeft > 0) {
+        input->buttons = replay->buttons;
+        replay->runLeft--;
+        return true;
+    }
+    if (replay->pos + 2 > replay->size) {
+        return false;
+    }
+
+    Uint8 buttons = replay->data[replay->pos];
+    int count = replay->data[replay->pos + 1];
+    replay->pos += 2;
+    input->buttons = buttons & ~RECORD_HAS_EDITS;
+    if (buttons & RECORD_HAS_EDITS) {
+        if (replay->pos + 1 > replay->size) return false;
+        int editCount = replay->data[replay->pos++];
+        if (editCount > MAX_TICK_EDITS || replay->pos + editCount * 4 > replay->size) return false;
+        for (int i = 0; i < editCount; i++) {
+            input->edits[i].x = readU16(replay->data + replay->pos);
+            input->edits[i].y = readU16(replay->data + replay->pos + 2);
+            replay->pos += 4;
+        }
+        input->editCount = editCount;
+    }
+    replay->buttons = input->buttons;
+    replay->runLeft = count - 1;
+    return count > 0;
+}
+
+float castRay(Player* player, float rayAngle) {
+    float rayX = player->x;
+    float rayY = player->y;
+    float stepX = cos(rayAngle * M_PI / 180);
+    float stepY = sin(rayAngle * M_PI / 180);
+    float distance = 0;
+
+    while (!isWall(rayX, rayY) && distance < SCREEN_WIDTH) {
+        // A wall at least d tiles away (in both axes) leaves d - 1 whole tiles
+        // of open space, so the ray can jump across them in one step
+        int step = 1;
+        int mapX = (int)rayX / TILE_SIZE;
+        int mapY = (int)rayY / TILE_SIZE;
+        if (rayX >= 0 && rayY >= 0 && mapX < map.width && mapY < map.height) {
+            int d = map.distField[mapY * map.width + mapX];
+            if (d > 1) {
+                step = (d - 1) * TILE_SIZE;
+                if (distance + step > SCREEN_WIDTH) step = SCREEN_WIDTH - distance;
+                if (step < 1) step = 1;
+            }
+        }
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+    }
+
+    return distance;
+}
+
+void render3DView(SDL_Renderer* renderer, Player* player) {
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float distance = castRay(player, rayAngle);
+
+        float wallHeight = WALL_HEIGHT / (distance * cos((rayAngle - player->angle) * M_PI / 180));
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+
+        // Render ceiling (roof)
+        SDL_SetRenderDrawColor(renderer, 50, 50, 100, 255);
+        SDL_RenderDrawLine(renderer, i, 0, i, wallTop);
+
+        // Render wall
+        SDL_SetRenderDrawColor(renderer, shade, shade, shade, 255);
+        SDL_RenderDrawLine(renderer, i, wallTop, i, wallBottom);
+
+        // Render floor
+        SDL_SetRenderDrawColor(renderer, 100, 50, 50, 255);
+        SDL_RenderDrawLine(renderer, i, wallBottom, i, SCREEN_HEIGHT);
+    }
+
+    // Render the player
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for player
+    SDL_Rect playerRect = { (int)(player->x - 5), (int)(player->y - 5), 10, 10 };
+    SDL_RenderFillRect(renderer, &playerRect);
+
+    // Render rays
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255); // Yellow for rays
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float distance = castRay(player, rayAngle);
+        float rayX = player->x + cos(rayAngle * M_PI / 180) * distance;
+        float rayY = player->y + sin(rayAngle * M_PI / 180) * distance;
+        SDL_RenderDrawLine(renderer, player->x, player->y, rayX, rayY);
+    }
+}
+
+void renderMap(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) == 1) {
+                SDL_Rect wallRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                SDL_RenderFillRect(renderer, &wallRect);
+            }
+        }
+    }
+}
+
+void renderMapEditor(SDL_Renderer* renderer) {
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            SDL_Rect tileRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+            if (getTile(x, y) == 1) {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Wall (1) - Red
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Empty (0) - White
+            }
+            SDL_RenderFillRect(renderer, &tileRect);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black border
+            SDL_RenderDrawRect(renderer, &tileRect);
+        }
+    }
+}
+
+// Convert a rendered ARGB frame and write it out. Only integer math is used, so
+// the output is byte-exact no matter how fast the host is.
+bool writeFrame(VideoExport* ex, SDL_Surface* surface) {
+    int w = surface->w;
+    int h = surface->h;
+    Uint8* out = ex->convertBuffer;
+    size_t size;
+
+    if (ex->y4m) {
+        int cw = (w + 1) / 2;
+        int ch = (h + 1) / 2;
+        Uint8* planeY = out + 6;
+        Uint8* planeU = planeY + w * h;
+        Uint8* planeV = planeU + cw * ch;
+        memcpy(out, "FRAME\n", 6);
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+                planeY[y * w + x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            }
+        }
+        for (int cy = 0; cy < ch; cy++) {
+            for (int cx = 0; cx < cw; cx++) {
+                // Average the 2x2 block, clamping at odd edges
+                int r = 0, g = 0, b = 0;
+                for (int k = 0; k < 4; k++) {
+                    int x = cx * 2 + (k & 1);
+                    int y = cy * 2 + (k >> 1);
+                    if (x >= w) x = w - 1;
+                    if (y >= h) y = h - 1;
+                    Uint32 p = ((Uint32*)((Uint8*)surface->pixels + y * surface->pitch))[x];
+                    r += (p >> 16) & 0xFF;
+                    g += (p >> 8) & 0xFF;
+                    b += p & 0xFF;
+                }
+                r = (r + 2) >> 2;
+                g = (g + 2) >> 2;
+                b = (b + 2) >> 2;
+                planeU[cy * cw + cx] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+                planeV[cy * cw + cx] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+            }
+        }
+        size = 6 + (size_t)w * h + 2 * (size_t)cw * ch;
+    } else {
+        int header = sprintf((char*)out, "P6\n%d %d\n255\n", w, h);
+        Uint8* rgb = out + header;
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                *rgb++ = (row[x] >> 16) & 0xFF;
+                *rgb++ = (row[x] >> 8) & 0xFF;
+                *rgb++ = row[x] & 0xFF;
+            }
+        }
+        size = header + (size_t)w * h * 3;
+    }
+    return fwrite(out, 1, size, ex->file) == size;
+}
+
+int exportWriterThread(void* data) {
+    VideoExport* ex = data;
+    int slot = 0;
+    while (true) {
+        SDL_SemWait(ex->fullSlots);
+        ExportSlot* s = &ex->slots[slot];
+        bool last = s->last;
+        if (!s->empty && !ex->failed && !writeFrame(ex, s->surface)) {
+            ex->failed = true;
+        }
+        SDL_SemPost(ex->freeSlots);
+        slot = (slot + 1) % EXPORT_RING_SIZE;
+        if (last) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// Free what startExport made. Whatever it didn't get to is NULL.
+void freeExportBuffers(VideoExport* ex) {
+    for (int i = 0; i < EXPORT_RING_SIZE; i++) {
+        if (ex->slots[i].renderer != NULL) SDL_DestroyRenderer(ex->slots[i].renderer);
+        if (ex->slots[i].surface != NULL) SDL_FreeSurface(ex->slots[i].surface);
+    }
+    if (ex->freeSlots != NULL) SDL_DestroySemaphore(ex->freeSlots);
+    if (ex->fullSlots != NULL) SDL_DestroySemaphore(ex->fullSlots);
+    free(ex->convertBuffer);
+}
+
+bool startExport(VideoExport* ex, const char* path) {
+    size_t len = strlen(path);
+    ex->y4m = len > 4 && strcmp(path + len - 4, ".y4m") == 0;
+    ex->failed = false;
+    ex->file = fopen(path, "wb");
+    if (ex->file == NULL) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+    if (ex->y4m) {
+        fprintf(ex->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, EXPORT_FPS);
+    }
+    memset(ex->slots, 0, sizeof(ex->slots));
+    ex->freeSlots = NULL;
+    ex->fullSlots = NULL;
+    ex->convertBuffer = malloc(64 + (size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+    bool ok = ex->convertBuffer != NULL;
+    if (!ok) {
+        printf("Not enough memory to export\n");
+    }
+    for (int i = 0; ok && i < EXPORT_RING_SIZE; i++) {
+        ex->slots[i].surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        ex->slots[i].renderer = ex->slots[i].surface ? SDL_CreateSoftwareRenderer(ex->slots[i].surface) : NULL;
+        if (ex->slots[i].renderer == NULL) {
+            printf("Could not create offscreen renderer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (ok) {
+        ex->freeSlots = SDL_CreateSemaphore(EXPORT_RING_SIZE);
+        ex->fullSlots = SDL_CreateSemaphore(0);
+        ex->writer = NULL;
+        if (ex->freeSlots != NULL && ex->fullSlots != NULL) {
+            ex->writer = SDL_CreateThread(exportWriterThread, "export writer", ex);
+        }
+        if (ex->writer == NULL) {
+            printf("Could not start the export writer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (!ok) {
+        freeExportBuffers(ex);
+        fclose(ex->file);
+        return false;
+    }
+    return true;
+}
+
+// Grab the next free ring slot, blocking only if the writer is a full ring behind
+ExportSlot* beginExportFrame(VideoExport* ex, int frame) {
+    SDL_SemWait(ex->freeSlots);
+    return &ex->slots[frame % EXPORT_RING_SIZE];
+}
+
+void endExportFrame(VideoExport* ex, ExportSlot* slot, bool last) {
+    slot->last = last;
+    SDL_SemPost(ex->fullSlots);
+}
+
+// Let the writer finish without handing it another frame
+void stopExport(VideoExport* ex, int frame) {
+    ExportSlot* slot = beginExportFrame(ex, frame);
+    slot->empty = true;
+    endExportFrame(ex, slot, true);
+}
+
+bool finishExport(VideoExport* ex) {
+    SDL_WaitThread(ex->writer, NULL);
+    freeExportBuffers(ex);
+    if (fclose(ex->file) != 0) {
+        ex->failed = true;
+    }
+    return !ex->failed;
+}
+
+// Camera path files have one "frame x y angle" keyframe per line
+int loadCameraPath(const char* path, PathKey* keys) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Could not open camera path %s\n", path);
+        return 0;
+    }
+    int count = 0;
+    PathKey key;
+    while (count < MAX_PATH_KEYS && fscanf(file, "%d %f %f %f", &key.frame, &key.pose.x, &key.pose.y, &key.pose.angle) == 4) {
+        if (count > 0 && key.frame <= keys[count - 1].frame) {
+            printf("Camera path %s: keyframes must be in increasing frame order\n", path);
+            fclose(file);
+            return 0;
+        }
+        keys[count++] = key;
+    }
+    fclose(file);
+    if (count == 0) {
+        printf("Camera path %s has no keyframes\n", path);
+    }
+    return count;
+}
+
+void cameraPathPose(PathKey* keys, int count, int frame, Player* pose) {
+    int k = 0;
+    while (k + 1 < count && keys[k + 1].frame <= frame) k++;
+    if (k + 1 >= count || frame <= keys[k].frame) {
+        *pose = keys[k].pose;
+        return;
+    }
+    float t = (float)(frame - keys[k].frame) / (keys[k + 1].frame - keys[k].frame);
+    pose->x = keys[k].pose.x + (keys[k + 1].pose.x - keys[k].pose.x) * t;
+    pose->y = keys[k].pose.y + (keys[k + 1].pose.y - keys[k].pose.y) * t;
+    pose->angle = keys[k].pose.angle + (keys[k + 1].pose.angle - keys[k].pose.angle) * t;
+}
+
+// Render a replay or camera path to a video file without opening any windows
+int runExport(const char* exportPath, InputReplay* replay, const char* pathFile, Player* player) {
+    static PathKey keys[MAX_PATH_KEYS];
+    int keyCount = 0;
+    if (pathFile != NULL) {
+        keyCount = loadCameraPath(pathFile, keys);
+        if (keyCount == 0) return 1;
+    }
+
+    VideoExport ex;
+    if (!startExport(&ex, exportPath)) {
+        return 1;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    int frame = 0;
+    bool more = true;
+    TickInput input;
+    while (more) {
+        if (replay->data != NULL) {
+            if (!replayTick(replay, &input)) {
+                // Past the first frame this only happens on a cut-off or
+                // damaged replay, whose last frame wasn't flagged
+                break;
+            }
+            simulateTick(player, &input);
+            // Peek ahead so the final frame can be flagged for the writer
+            more = replay->runLeft > 0 || replay->pos + 2 <= replay->size;
+        } else {
+            cameraPathPose(keys, keyCount, frame, player);
+            more = frame < keys[keyCount - 1].frame;
+        }
+
+        ExportSlot* slot = beginExportFrame(&ex, frame);
+        SDL_SetRenderDrawColor(slot->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(slot->renderer);
+        render3DView(slot->renderer, player);
+        endExportFrame(&ex, slot, !more);
+        frame++;
+    }
+    bool cutOff = more && frame > 0;
+    if (cutOff) {
+        stopExport(&ex, frame);
+    }
+    if (frame == 0) {
+        // Empty replay: still hand the writer a frame so it can exit
+        ExportSlot* slot = beginExportFrame(&ex, 0);
+        SDL_SetRenderDrawColor(slot->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(slot->renderer);
+        render3DView(slot->renderer, player);
+        endExportFrame(&ex, slot, true);
+        frame = 1;
+    }
+
+    bool ok = finishExport(&ex);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    if (!ok) {
+        printf("Writing %s failed\n", exportPath);
+        return 1;
+    }
+    if (cutOff) {
+        printf("The replay is cut off or damaged, only its first %d frames went to %s\n", frame, exportPath);
+        return 1;
+    }
+    printf("Exported %d frames to %s in %.2f s (%.1f fps)\n", frame, exportPath, seconds, frame / seconds);
+    return 0;
+}
+
+// Move the player to the first open tile if the start position is inside a wall
+void placePlayer(Player* player) {
+    if (!isWall(player->x, player->y)) return;
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) != 1) {
+                player->x = x * TILE_SIZE + TILE_SIZE / 2;
+                player->y = y * TILE_SIZE + TILE_SIZE / 2;
+                return;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: raycastv-4.05 [map.rcm] [--record file.rcr | --replay file.rcr] [--hashes file.txt]
+    //                     [--export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)]
+    // F2 saves the (edited) map to the same file, or to map.rcm by default.
+    const char* mapPath = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* hashPath = NULL;
+    const char* exportPath = NULL;
+    const char* cameraPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--hashes") == 0 && i + 1 < argc) {
+            hashPath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            cameraPath = argv[++i];
+        } else if (argv[i][0] != '-' && mapPath == NULL) {
+            mapPath = argv[i];
+        } else {
+            printf("Usage: %s [map.rcm] [--record file.rcr | --replay file.rcr] [--hashes file.txt]\n", argv[0]);
+            printf("       %s [map.rcm] --export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)\n", argv[0]);
+            return 1;
+        }
+    }
+    if (exportPath != NULL && (replayPath == NULL) == (cameraPath == NULL)) {
+        printf("--export needs exactly one of --replay or --path\n");
+        return 1;
+    }
+    if (mapPath != NULL) {
+        if (!loadMapFile(mapPath, &map)) {
+            return 1;
+        }
+    } else {
+        mapPath = "map.rcm";
+        loadDefaultMap(&map);
+    }
+
+    if (exportPath != NULL) {
+        Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+        placePlayer(&player);
+        InputReplay replay = { NULL };
+        if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+            return 1;
+        }
+        int result = runExport(exportPath, &replay, cameraPath, &player);
+        free(replay.data);
+        freeMap(&map);
+        return result;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Create main game window
+    SDL_Window* mainWindow = SDL_CreateWindow("Raycasting Game",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    // Create 3D view window
+    SDL_Window* viewWindow = SDL_CreateWindow("3D View",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* viewRenderer = SDL_CreateRenderer(viewWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    // Create map editor window
+    SDL_Window* editorWindow = SDL_CreateWindow("Map Editor",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, map.width * TILE_SIZE, map.height * TILE_SIZE, SDL_WINDOW_SHOWN);
+    SDL_Renderer* editorRenderer = SDL_CreateRenderer(editorWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+    placePlayer(&player);
+
+    InputRecorder recorder = { NULL };
+    InputReplay replay = { NULL };
+    FILE* hashFile = NULL;
+    if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+        return 1;
+    }
+    if (recordPath != NULL && !startRecording(&recorder, recordPath, &player)) {
+        return 1;
+    }
+    if (hashPath != NULL) {
+        hashFile = fopen(hashPath, "w");
+        if (hashFile == NULL) {
+            printf("Could not create hash log %s\n", hashPath);
+            return 1;
+        }
+    }
+
+    bool quit = false;
+    const Uint8* keystate;
+    SDL_Event e;
+    TickInput input;
+    Uint32 tick = 0;
+
+    while (!quit) {
+        input.editCount = 0;
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            // Save the map
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2) {
+                if (saveMapFile(mapPath, &map)) {
+                    printf("Saved map to %s\n", mapPath);
+                }
+            }
+            // Map editor mouse click handling
+            if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && replay.data == NULL) {
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+                int gridX = mouseX / TILE_SIZE;
+                int gridY = mouseY / TILE_SIZE;
+                if (gridX >= 0 && gridX < map.width && gridY >= 0 && gridY < map.height && input.editCount < MAX_TICK_EDITS) {
+                    input.edits[input.editCount].x = gridX;
+                    input.edits[input.editCount].y = gridY;
+                    input.editCount++;
+                }
+            }
+        }
+        if (quit) {
+            break;
+        }
+
+        if (replay.data != NULL) {
+            // The recording replaces the keyboard and mouse entirely
+            if (!replayTick(&replay, &input)) {
+                break;
+            }
+        } else {
+            keystate = SDL_GetKeyboardState(NULL);
+            input.buttons = 0;
+            if (keystate[SDL_SCANCODE_W]) input.buttons |= INPUT_FORWARD;
+            if (keystate[SDL_SCANCODE_S]) input.buttons |= INPUT_BACK;
+            if (keystate[SDL_SCANCODE_A]) input.buttons |= INPUT_LEFT;
+            if (keystate[SDL_SCANCODE_D]) input.buttons |= INPUT_RIGHT;
+        }
+
+        if (recorder.file != NULL) {
+            recordTick(&recorder, &input);
+        }
+        simulateTick(&player, &input);
+        tick++;
+        if (hashFile != NULL) {
+            fprintf(hashFile, "%u %016llx\n", tick, (unsigned long long)stateHash(&player));
+        }
+
+        // Render the 3D view
+        SDL_SetRenderDrawColor(viewRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(viewRenderer);
+        render3DView(viewRenderer, &player);
+        SDL_RenderPresent(viewRenderer);
+
+        // Render the main game window
+        SDL_SetRenderDrawColor(mainRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(mainRenderer);
+        renderMap(mainRenderer);
+        SDL_RenderPresent(mainRenderer);
+
+        // Render the map editor
+        SDL_SetRenderDrawColor(editorRenderer, 255, 255, 255, 255);
+        SDL_RenderClear(editorRenderer);
+        renderMapEditor(editorRenderer);
+        SDL_RenderPresent(editorRenderer);
+    }
+
+    SDL_DestroyRenderer(mainRenderer);
+    SDL_DestroyWindow(mainWindow);
+    SDL_DestroyRenderer(viewRenderer);
+    SDL_DestroyWindow(viewWindow);
+    SDL_DestroyRenderer(editorRenderer);
+    SDL_DestroyWindow(editorWindow);
+    SDL_Quit();
+
+    if (recorder.file != NULL) {
+        stopRecording(&recorder);
+    }
+    if (hashFile != NULL) {
+        fclose(hashFile);
+    }
+    if (replay.data != NULL) {
+        printf("Replayed %u ticks, final state hash %016llx\n", tick, (unsigned long long)stateHash(&player));
+        free(replay.data);
+    }
+    freeMap(&map);
+
+    return 0;
+}
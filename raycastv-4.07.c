@@ -0,0 +1,1928 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define FOV 60
+#define NUM_RAYS SCREEN_WIDTH
+#define TILE_SIZE 64
+#define MAP_WIDTH 10   // Size of the built-in map used when no map file is given
+#define MAP_HEIGHT 8
+#define WALL_HEIGHT 4000  // Set wall height to 4000 for taller walls
+
+#define MAX_MAP_SIDE 65536  // Largest map width/height a map file may declare
+#define MAX_DIST_FIELD 255  // Distance field values are stored in one byte
+
+// Map file format (.rcm), all numbers little-endian:
+//   header:  "RCMP", u16 version, u16 layer count, u32 width, u32 height,
+//            u32 CRC32 of everything after the header
+//   layers:  u8 type, u8 encoding, u16 reserved, u32 encoded size, data
+// Tile layers hold width * height bytes once decoded; the light layer holds a
+// u32 count and then x, y, width, height, radius, intensity as f32 per light.
+// Unknown layer types are skipped so newer files still open in older versions.
+#define MAP_MAGIC "RCMP"
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 20
+#define LAYER_HEADER_SIZE 8
+#define LAYER_TILES 1
+#define LAYER_DIST_FIELD 2  // Precomputed so loading doesn't have to rebuild it
+#define LAYER_LIGHTS 3
+#define LIGHT_RECORD_SIZE 24
+#define ENCODING_RAW 0
+#define ENCODING_RLE 1
+
+// Input recording format (.rcr), little-endian:
+//   header:  "RCRP", u16 version, u16 reserved, u32 CRC32 of the map tiles,
+//            f32 start x, f32 start y, f32 start angle
+//   records: u8 buttons, u8 tick count, and when RECORD_HAS_EDITS is set,
+//            u8 edit count followed by u16 x, u16 y per toggled tile
+// Ticks without edits are run-length merged, so holding a key costs 2 bytes
+// per 255 ticks.
+#define RECORD_MAGIC "RCRP"
+#define RECORD_VERSION 1
+#define RECORD_HEADER_SIZE 24
+#define RECORD_HAS_EDITS 0x80
+
+#define INPUT_FORWARD 1
+#define INPUT_BACK 2
+#define INPUT_LEFT 4
+#define INPUT_RIGHT 8
+#define MAX_TICK_EDITS 32
+
+// Offscreen export: frames are rendered into a ring of preallocated surfaces and
+// a writer thread converts and writes them while the next frame renders
+#define EXPORT_RING_SIZE 4
+#define EXPORT_FPS 60
+#define MAX_PATH_KEYS 1024
+
+// Static lighting is baked into lightmaps that the renderer only has to look up
+#define MAX_LIGHTS 64
+#define LIGHTMAP_FACE_RES 8   // Texels along each wall face
+#define LIGHTMAP_FLOOR_RES 4  // Texels along each side of a floor tile
+#define AMBIENT_LIGHT 48
+#define AREA_LIGHT_SAMPLES 3  // Area lights are baked as a 3x3 grid of point lights
+#define MAX_LIGHT_JOBS 64
+
+// Indexed colour mode: 8-bit textures and a colormap of light level x palette
+// index, so shading a pixel is one table lookup
+#define TEXTURE_SIZE 64
+#define MAX_LIGHT_LEVELS 256
+#define DEFAULT_LIGHT_LEVELS 32
+#define PALETTE_GREY 0      // 64-entry ramps in the palette
+#define PALETTE_BRICK 64
+#define PALETTE_FLOOR 128
+#define PALETTE_CEILING 192
+
+typedef struct {
+    float x, y;
+    float angle;
+} Player;
+
+typedef struct {
+    float x, y;           // Centre in world units
+    float width, height;  // 0 for a point light, otherwise the size of an area light
+    float radius;         // Light falls off linearly to nothing at this distance
+    float intensity;      // Light level added right next to the light (0-255)
+} Light;
+
+typedef struct {
+    int width, height;
+    Uint8* tiles;      // width * height tiles, row-major, 1 is a wall
+    Uint8* distField;  // Distance in tiles to the nearest wall (8-neighbour), 0 on walls
+    Uint64 hash;       // Hash of all tiles, updated by setTile on every edit
+    Light lights[MAX_LIGHTS];
+    int lightCount;    // No lights means the map is drawn fully lit
+} Map;
+
+typedef struct {
+    int x0, y0, x1, y1;  // Tiles x0 <= x < x1, y0 <= y < y1
+} TileRect;
+
+// Where a ray stopped; mapX is -1 when it ran out of range without hitting a wall
+typedef struct {
+    float distance;
+    int mapX, mapY;
+    int face;   // 0 west, 1 east, 2 north, 3 south, same order as the lightmaps
+    float u;    // Position along the face, 0-1
+} RayHit;
+
+// Read-only view of the tiles inside rect, so the bake thread can work on a
+// private copy while the editor keeps changing the real map
+typedef struct {
+    TileRect rect;
+    const Uint8* tiles;
+} TileView;
+
+// Light levels (0-255) for every wall face and floor tile
+typedef struct {
+    Uint8* wall;   // Per tile: 4 faces (west, east, north, south) * LIGHTMAP_FACE_RES
+    Uint8* floor;  // Per tile: LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES, row-major
+} Lightmaps;
+
+typedef struct {
+    TileRect rect;     // Tiles to rebake
+    TileView view;     // Snapshot of every tile a light reaching rect can see
+    Uint8* wall;       // Results for rect, copied into the live lightmaps when done
+    Uint8* floor;
+} LightJob;
+
+// Background rebaking after editor changes
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;     // Guards the queue and the live lightmaps
+    SDL_cond* changed;
+    LightJob* jobs[MAX_LIGHT_JOBS];
+    int head, count;
+    bool quit;
+    bool synchronous;    // Bake on the caller instead, for byte-exact exports
+} LightBaker;
+
+// Simple 2D map where 1 represents a wall and 0 is empty space
+int defaultMap[MAP_HEIGHT][MAP_WIDTH] = {
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 1, 0, 0, 1},
+    {1, 0, 0, 0, 0, 1, 1, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
+
+typedef struct {
+    Uint16 x, y;
+} TileEdit;
+
+// Everything the simulation reads from the user during one tick
+typedef struct {
+    Uint8 buttons;
+    int editCount;
+    TileEdit edits[MAX_TICK_EDITS];
+} TickInput;
+
+typedef struct {
+    FILE* file;
+    Uint8 buttons;  // Pending run of edit-free ticks
+    int runLength;
+} InputRecorder;
+
+typedef struct {
+    Uint8* data;
+    size_t size;
+    size_t pos;
+    Uint8 buttons;  // Current run being played back
+    int runLeft;
+} InputReplay;
+
+// One camera path keyframe; poses in between are interpolated linearly
+typedef struct {
+    int frame;
+    Player pose;
+} PathKey;
+
+typedef struct {
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;
+    bool last;  // Set on the final frame so the writer knows to stop
+    bool empty; // No frame in it, only there to stop the writer
+} ExportSlot;
+
+typedef struct {
+    FILE* file;
+    bool y4m;            // YUV4MPEG2 4:2:0, otherwise a sequence of binary PPMs
+    Uint8* convertBuffer;
+    ExportSlot slots[EXPORT_RING_SIZE];
+    SDL_sem* freeSlots;
+    SDL_sem* fullSlots;
+    SDL_Thread* writer;
+    bool failed;
+} VideoExport;
+
+Map map;
+Lightmaps lightmaps;
+LightBaker baker;
+
+bool indexedMode = false;
+int lightLevels = DEFAULT_LIGHT_LEVELS;
+Uint32 palette[256];
+Uint32 colormap[MAX_LIGHT_LEVELS][256];
+Uint8 wallTexture[TEXTURE_SIZE][TEXTURE_SIZE];   // Indexed as [x][y] so a wall column is contiguous
+Uint8 floorTexture[TEXTURE_SIZE][TEXTURE_SIZE];  // Indexed as [y][x]
+
+// Default lights for the built-in map: one bulb and one ceiling panel
+Light defaultLights[] = {
+    { 288, 96, 0, 0, 320, 220 },
+    { 480, 352, 64, 32, 256, 180 }
+};
+
+int getTile(int x, int y) {
+    return map.tiles[y * map.width + x];
+}
+
+Uint64 mixHash(Uint64 v) {
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+}
+
+// Per-tile terms are XORed together so a single edit can be patched in O(1)
+Uint64 tileHash(size_t index, int value) {
+    return value == 0 ? 0 : mixHash(((Uint64)index << 8) | value);
+}
+
+Uint64 hashTiles(Map* m) {
+    Uint64 hash = 0;
+    size_t count = (size_t)m->width * m->height;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= tileHash(i, m->tiles[i]);
+    }
+    return hash;
+}
+
+// Rebuild the distance field with a two-pass chamfer sweep. Every step costs 1,
+// so the result is the exact Chebyshev distance to the nearest wall tile.
+void buildDistanceField(Map* m) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = w - 1; x >= 0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+bool viewIsWall(TileView* view, int x, int y) {
+    TileRect* r = &view->rect;
+    if (x < r->x0 || x >= r->x1 || y < r->y0 || y >= r->y1) {
+        return false;
+    }
+    return view->tiles[(y - r->y0) * (r->x1 - r->x0) + (x - r->x0)] == 1;
+}
+
+// Walk the tiles between two points (grid DDA) and report whether a wall is in
+// the way. The tiles holding the two end points are not tested.
+bool lineOfSight(TileView* view, float x0, float y0, float x1, float y1) {
+    int cellX = (int)floorf(x0 / TILE_SIZE);
+    int cellY = (int)floorf(y0 / TILE_SIZE);
+    int endX = (int)floorf(x1 / TILE_SIZE);
+    int endY = (int)floorf(y1 / TILE_SIZE);
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    float tDeltaX = dx != 0 ? fabsf(TILE_SIZE / dx) : INFINITY;
+    float tDeltaY = dy != 0 ? fabsf(TILE_SIZE / dy) : INFINITY;
+    float tMaxX = dx > 0 ? ((cellX + 1) * TILE_SIZE - x0) / dx : dx < 0 ? (cellX * TILE_SIZE - x0) / dx : INFINITY;
+    float tMaxY = dy > 0 ? ((cellY + 1) * TILE_SIZE - y0) / dy : dy < 0 ? (cellY * TILE_SIZE - y0) / dy : INFINITY;
+
+    int steps = abs(endX - cellX) + abs(endY - cellY);
+    for (int i = 0; i < steps - 1; i++) {
+        if (tMaxX < tMaxY) {
+            tMaxX += tDeltaX;
+            cellX += stepX;
+        } else {
+            tMaxY += tDeltaY;
+            cellY += stepY;
+        }
+        if (viewIsWall(view, cellX, cellY)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Light arriving at a point from every light. (nx, ny) is the surface normal,
+// or (0, 0) for the floor, which takes light from every direction.
+int lightAt(Light* lights, int lightCount, TileView* view, float px, float py, float nx, float ny) {
+    float total = AMBIENT_LIGHT;
+    for (int l = 0; l < lightCount; l++) {
+        Light* light = &lights[l];
+        int samples = (light->width > 0 || light->height > 0) ? AREA_LIGHT_SAMPLES : 1;
+        for (int sy = 0; sy < samples; sy++) {
+            for (int sx = 0; sx < samples; sx++) {
+                float lx = light->x;
+                float ly = light->y;
+                if (samples > 1) {
+                    lx += light->width * ((sx + 0.5f) / samples - 0.5f);
+                    ly += light->height * ((sy + 0.5f) / samples - 0.5f);
+                }
+                float dx = lx - px;
+                float dy = ly - py;
+                float dist = sqrtf(dx * dx + dy * dy);
+                if (dist >= light->radius) continue;
+
+                float facing = 1;
+                if (nx != 0 || ny != 0) {
+                    facing = dist > 0 ? (dx * nx + dy * ny) / dist : 1;
+                    if (facing <= 0) continue;
+                }
+                if (!lineOfSight(view, lx, ly, px, py)) continue;
+                total += light->intensity * (1 - dist / light->radius) * facing / (samples * samples);
+            }
+        }
+    }
+    return total > 255 ? 255 : (int)total;
+}
+
+// Bake every wall face and floor texel of the tiles in rect. The output arrays
+// are laid out for rect only, with the same per-tile layout as the lightmaps.
+void bakeLightmaps(Light* lights, int lightCount, TileView* view, TileRect rect, Uint8* wallOut, Uint8* floorOut) {
+    static const int normals[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    int rectWidth = rect.x1 - rect.x0;
+    float nudge = 0.5f;  // Sample just outside the face so its own tile isn't in the way
+
+    for (int ty = rect.y0; ty < rect.y1; ty++) {
+        for (int tx = rect.x0; tx < rect.x1; tx++) {
+            size_t index = (size_t)(ty - rect.y0) * rectWidth + (tx - rect.x0);
+            Uint8* wall = wallOut + index * 4 * LIGHTMAP_FACE_RES;
+            Uint8* floor = floorOut + index * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES;
+
+            if (viewIsWall(view, tx, ty)) {
+                memset(floor, AMBIENT_LIGHT, LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+                for (int face = 0; face < 4; face++) {
+                    int nx = normals[face][0];
+                    int ny = normals[face][1];
+                    if (viewIsWall(view, tx + nx, ty + ny)) {
+                        // Face is buried against another wall and never drawn
+                        memset(wall + face * LIGHTMAP_FACE_RES, AMBIENT_LIGHT, LIGHTMAP_FACE_RES);
+                        continue;
+                    }
+                    for (int t = 0; t < LIGHTMAP_FACE_RES; t++) {
+                        float along = (t + 0.5f) * TILE_SIZE / LIGHTMAP_FACE_RES;
+                        float px, py;
+                        if (nx != 0) {
+                            px = tx * TILE_SIZE + (nx > 0 ? TILE_SIZE + nudge : -nudge);
+                            py = ty * TILE_SIZE + along;
+                        } else {
+                            px = tx * TILE_SIZE + along;
+                            py = ty * TILE_SIZE + (ny > 0 ? TILE_SIZE + nudge : -nudge);
+                        }
+                        wall[face * LIGHTMAP_FACE_RES + t] = lightAt(lights, lightCount, view, px, py, nx, ny);
+                    }
+                }
+            } else {
+                memset(wall, AMBIENT_LIGHT, 4 * LIGHTMAP_FACE_RES);
+                for (int fy = 0; fy < LIGHTMAP_FLOOR_RES; fy++) {
+                    for (int fx = 0; fx < LIGHTMAP_FLOOR_RES; fx++) {
+                        float px = tx * TILE_SIZE + (fx + 0.5f) * TILE_SIZE / LIGHTMAP_FLOOR_RES;
+                        float py = ty * TILE_SIZE + (fy + 0.5f) * TILE_SIZE / LIGHTMAP_FLOOR_RES;
+                        floor[fy * LIGHTMAP_FLOOR_RES + fx] = lightAt(lights, lightCount, view, px, py, 0, 0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool allocLightmaps(Lightmaps* lm, int width, int height) {
+    size_t tiles = (size_t)width * height;
+    lm->wall = malloc(tiles * 4 * LIGHTMAP_FACE_RES);
+    lm->floor = malloc(tiles * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+    return lm->wall != NULL && lm->floor != NULL;
+}
+
+void freeLightmaps(Lightmaps* lm) {
+    free(lm->wall);
+    free(lm->floor);
+    lm->wall = lm->floor = NULL;
+}
+
+// Full bake of the live map, used once at startup
+void bakeAllLightmaps(void) {
+    TileRect all = { 0, 0, map.width, map.height };
+    TileView view = { all, map.tiles };
+    bakeLightmaps(map.lights, map.lightCount, &view, all, lightmaps.wall, lightmaps.floor);
+}
+
+// Reach of the strongest light in tiles, used to size job snapshots
+int maxLightReach(void) {
+    float reach = 0;
+    for (int l = 0; l < map.lightCount; l++) {
+        float r = map.lights[l].radius + fmaxf(map.lights[l].width, map.lights[l].height) / 2;
+        if (r > reach) reach = r;
+    }
+    return (int)ceilf(reach / TILE_SIZE) + 1;
+}
+
+TileRect clipRect(TileRect r) {
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > map.width) r.x1 = map.width;
+    if (r.y1 > map.height) r.y1 = map.height;
+    return r;
+}
+
+void runLightJob(LightJob* job) {
+    bakeLightmaps(map.lights, map.lightCount, &job->view, job->rect, job->wall, job->floor);
+
+    // Publish the results; the renderer holds the lock while it samples
+    SDL_LockMutex(baker.lock);
+    int rectWidth = job->rect.x1 - job->rect.x0;
+    size_t wallRow = (size_t)rectWidth * 4 * LIGHTMAP_FACE_RES;
+    size_t floorRow = (size_t)rectWidth * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES;
+    for (int y = job->rect.y0; y < job->rect.y1; y++) {
+        size_t live = (size_t)y * map.width + job->rect.x0;
+        memcpy(lightmaps.wall + live * 4 * LIGHTMAP_FACE_RES, job->wall + (y - job->rect.y0) * wallRow, wallRow);
+        memcpy(lightmaps.floor + live * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES, job->floor + (y - job->rect.y0) * floorRow, floorRow);
+    }
+    SDL_UnlockMutex(baker.lock);
+}
+
+void freeLightJob(LightJob* job) {
+    free((void*)job->view.tiles);
+    free(job->wall);
+    free(job->floor);
+    free(job);
+}
+
+int lightBakeThread(void* data) {
+    SDL_LockMutex(baker.lock);
+    while (true) {
+        while (baker.count == 0 && !baker.quit) {
+            SDL_CondWait(baker.changed, baker.lock);
+        }
+        if (baker.quit) {
+            break;
+        }
+        LightJob* job = baker.jobs[baker.head];
+        baker.head = (baker.head + 1) % MAX_LIGHT_JOBS;
+        baker.count--;
+        SDL_CondSignal(baker.changed);
+        SDL_UnlockMutex(baker.lock);
+
+        runLightJob(job);
+        freeLightJob(job);
+        SDL_LockMutex(baker.lock);
+    }
+    SDL_UnlockMutex(baker.lock);
+    return 0;
+}
+
+void startLightBaker(bool synchronous) {
+    baker.lock = SDL_CreateMutex();
+    baker.changed = SDL_CreateCond();
+    baker.head = baker.count = 0;
+    baker.quit = false;
+    baker.synchronous = synchronous;
+    baker.thread = synchronous ? NULL : SDL_CreateThread(lightBakeThread, "light baker", NULL);
+}
+
+void stopLightBaker(void) {
+    if (baker.thread != NULL) {
+        SDL_LockMutex(baker.lock);
+        baker.quit = true;
+        SDL_CondSignal(baker.changed);
+        SDL_UnlockMutex(baker.lock);
+        SDL_WaitThread(baker.thread, NULL);
+        while (baker.count > 0) {
+            freeLightJob(baker.jobs[baker.head]);
+            baker.head = (baker.head + 1) % MAX_LIGHT_JOBS;
+            baker.count--;
+        }
+    }
+    SDL_DestroyCond(baker.changed);
+    SDL_DestroyMutex(baker.lock);
+}
+
+// Queue a rebake of everything a change to tile (x, y) can affect: the tile and
+// its neighbours, plus the whole area of every light that reaches it
+void relightTile(int x, int y) {
+    if (map.lightCount == 0 || baker.lock == NULL) {
+        return;
+    }
+
+    TileRect rect = { x - 1, y - 1, x + 2, y + 2 };
+    for (int l = 0; l < map.lightCount; l++) {
+        Light* light = &map.lights[l];
+        float reach = light->radius + fmaxf(light->width, light->height) / 2;
+        float nearX = fmaxf(x * TILE_SIZE, fminf(light->x, (x + 1) * TILE_SIZE));
+        float nearY = fmaxf(y * TILE_SIZE, fminf(light->y, (y + 1) * TILE_SIZE));
+        if (hypotf(light->x - nearX, light->y - nearY) >= reach) continue;
+
+        int x0 = (int)floorf((light->x - reach) / TILE_SIZE);
+        int y0 = (int)floorf((light->y - reach) / TILE_SIZE);
+        int x1 = (int)floorf((light->x + reach) / TILE_SIZE) + 1;
+        int y1 = (int)floorf((light->y + reach) / TILE_SIZE) + 1;
+        if (x0 < rect.x0) rect.x0 = x0;
+        if (y0 < rect.y0) rect.y0 = y0;
+        if (x1 > rect.x1) rect.x1 = x1;
+        if (y1 > rect.y1) rect.y1 = y1;
+    }
+    rect = clipRect(rect);
+
+    // Snapshot every tile that a shadow ray for this area can cross
+    int reach = maxLightReach();
+    TileRect snap = clipRect((TileRect){ rect.x0 - reach, rect.y0 - reach, rect.x1 + reach, rect.y1 + reach });
+    int snapWidth = snap.x1 - snap.x0;
+    Uint8* tiles = malloc((size_t)snapWidth * (snap.y1 - snap.y0));
+    for (int ty = snap.y0; ty < snap.y1; ty++) {
+        memcpy(tiles + (size_t)(ty - snap.y0) * snapWidth, map.tiles + (size_t)ty * map.width + snap.x0, snapWidth);
+    }
+
+    size_t rectTiles = (size_t)(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+    LightJob* job = malloc(sizeof(LightJob));
+    job->rect = rect;
+    job->view.rect = snap;
+    job->view.tiles = tiles;
+    job->wall = malloc(rectTiles * 4 * LIGHTMAP_FACE_RES);
+    job->floor = malloc(rectTiles * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+
+    if (baker.synchronous) {
+        runLightJob(job);
+        freeLightJob(job);
+        return;
+    }
+    SDL_LockMutex(baker.lock);
+    while (baker.count == MAX_LIGHT_JOBS) {
+        SDL_CondWait(baker.changed, baker.lock);
+    }
+    baker.jobs[(baker.head + baker.count) % MAX_LIGHT_JOBS] = job;
+    baker.count++;
+    SDL_CondSignal(baker.changed);
+    SDL_UnlockMutex(baker.lock);
+}
+
+void setTile(int x, int y, int value) {
+    size_t index = (size_t)y * map.width + x;
+    map.hash ^= tileHash(index, map.tiles[index]) ^ tileHash(index, value);
+    map.tiles[index] = value;
+    buildDistanceField(&map);
+    relightTile(x, y);
+}
+
+bool allocMap(Map* m, int width, int height) {
+    m->width = width;
+    m->height = height;
+    m->lightCount = 0;
+    m->tiles = malloc((size_t)width * height);
+    m->distField = malloc((size_t)width * height);
+    if (m->tiles == NULL || m->distField == NULL) {
+        free(m->tiles);
+        free(m->distField);
+        m->tiles = m->distField = NULL;
+        return false;
+    }
+    return true;
+}
+
+void freeMap(Map* m) {
+    free(m->tiles);
+    free(m->distField);
+    m->tiles = m->distField = NULL;
+}
+
+void loadDefaultMap(Map* m) {
+    allocMap(m, MAP_WIDTH, MAP_HEIGHT);
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            m->tiles[y * MAP_WIDTH + x] = defaultMap[y][x];
+        }
+    }
+    m->lightCount = sizeof(defaultLights) / sizeof(defaultLights[0]);
+    memcpy(m->lights, defaultLights, sizeof(defaultLights));
+    buildDistanceField(m);
+    m->hash = hashTiles(m);
+}
+
+Uint32 crcTable[256];
+
+Uint32 crc32(const Uint8* data, size_t size) {
+    if (crcTable[1] == 0) {
+        for (Uint32 i = 0; i < 256; i++) {
+            Uint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crcTable[i] = c;
+        }
+    }
+    Uint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+Uint32 readU32(const Uint8* p) {
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+Uint16 readU16(const Uint8* p) {
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+void writeU32(Uint8* p, Uint32 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void writeU16(Uint8* p, Uint16 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+Uint32 readF32Bits(const Uint8* p, float* value) {
+    Uint32 bits = readU32(p);
+    memcpy(value, &bits, 4);
+    return bits;
+}
+
+void writeF32(Uint8* p, float value) {
+    Uint32 bits;
+    memcpy(&bits, &value, 4);
+    writeU32(p, bits);
+}
+
+// Run-length encoding in PackBits style: a control byte c < 128 is followed by
+// c + 1 literal bytes, a control byte c >= 128 repeats the next byte c - 126 times.
+// Literals cost a control byte per 128, so alternating data grows by up to a
+// third; encoding stops and returns capacity once the output would not fit.
+size_t rleEncode(const Uint8* src, size_t size, Uint8* dst, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        size_t run = 1;
+        while (in + run < size && run < 129 && src[in + run] == src[in]) run++;
+        if (run >= 2) {
+            if (out + 2 > capacity) return capacity;
+            dst[out++] = (Uint8)(run + 126);
+            dst[out++] = src[in];
+            in += run;
+        } else {
+            size_t start = in;
+            size_t count = 0;
+            while (in < size && count < 128 && !(in + 1 < size && src[in + 1] == src[in])) {
+                in++;
+                count++;
+            }
+            if (out + 1 + count > capacity) return capacity;
+            dst[out++] = (Uint8)(count - 1);
+            memcpy(dst + out, src + start, count);
+            out += count;
+        }
+    }
+    return out;
+}
+
+// Decode straight into the destination layer; fails on any overrun or short data
+bool rleDecode(const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        Uint8 c = src[in++];
+        if (c < 128) {
+            size_t count = c + 1;
+            if (in + count > size || out + count > dstSize) return false;
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+        } else {
+            size_t count = c - 126;
+            if (in >= size || out + count > dstSize) return false;
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+    return out == dstSize;
+}
+
+bool decodeLayer(int encoding, const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    if (encoding == ENCODING_RAW) {
+        if (size != dstSize) return false;
+        memcpy(dst, src, size);
+        return true;
+    }
+    if (encoding == ENCODING_RLE) {
+        return rleDecode(src, size, dst, dstSize);
+    }
+    return false;
+}
+
+// Load a map file. The whole file is read with a single fread, checked, and then
+// every layer is decoded directly into the freshly allocated map.
+bool loadMapFile(const char* path, Map* out) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open map file %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (fileSize < MAP_HEADER_SIZE) {
+        printf("Map file %s is too small\n", path);
+        fclose(file);
+        return false;
+    }
+
+    Uint8* data = malloc(fileSize);
+    if (data == NULL || fread(data, 1, fileSize, file) != (size_t)fileSize) {
+        printf("Could not read map file %s\n", path);
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    Uint16 version = readU16(data + 4);
+    int layerCount = readU16(data + 6);
+    Uint32 width = readU32(data + 8);
+    Uint32 height = readU32(data + 12);
+    Uint32 checksum = readU32(data + 16);
+    if (memcmp(data, MAP_MAGIC, 4) != 0 || version != MAP_VERSION) {
+        printf("%s is not a version %d map file\n", path, MAP_VERSION);
+        free(data);
+        return false;
+    }
+    if (width == 0 || height == 0 || width > MAX_MAP_SIDE || height > MAX_MAP_SIDE) {
+        printf("Map file %s has bad dimensions %ux%u\n", path, width, height);
+        free(data);
+        return false;
+    }
+    if (crc32(data + MAP_HEADER_SIZE, fileSize - MAP_HEADER_SIZE) != checksum) {
+        printf("Map file %s failed its checksum\n", path);
+        free(data);
+        return false;
+    }
+
+    Map m;
+    if (!allocMap(&m, width, height)) {
+        printf("Not enough memory for a %ux%u map\n", width, height);
+        free(data);
+        return false;
+    }
+
+    size_t layerSize = (size_t)width * height;
+    size_t pos = MAP_HEADER_SIZE;
+    bool haveTiles = false;
+    bool haveDistField = false;
+    for (int i = 0; i < layerCount; i++) {
+        if (pos + LAYER_HEADER_SIZE > (size_t)fileSize) break;
+        int type = data[pos];
+        int encoding = data[pos + 1];
+        size_t size = readU32(data + pos + 4);
+        pos += LAYER_HEADER_SIZE;
+        if (size > (size_t)fileSize - pos) break;
+
+        Uint8* dst = NULL;
+        if (type == LAYER_TILES) dst = m.tiles;
+        if (type == LAYER_DIST_FIELD) dst = m.distField;
+        if (dst != NULL) {
+            if (!decodeLayer(encoding, data + pos, size, dst, layerSize)) {
+                printf("Map file %s has a corrupt layer %d\n", path, type);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            if (type == LAYER_TILES) haveTiles = true;
+            if (type == LAYER_DIST_FIELD) haveDistField = true;
+        }
+        if (type == LAYER_LIGHTS) {
+            Uint32 count = size >= 4 ? readU32(data + pos) : 0;
+            if (encoding != ENCODING_RAW || count > MAX_LIGHTS || size != 4 + count * LIGHT_RECORD_SIZE) {
+                printf("Map file %s has a corrupt light layer\n", path);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            for (Uint32 l = 0; l < count; l++) {
+                const Uint8* p = data + pos + 4 + l * LIGHT_RECORD_SIZE;
+                readF32Bits(p, &m.lights[l].x);
+                readF32Bits(p + 4, &m.lights[l].y);
+                readF32Bits(p + 8, &m.lights[l].width);
+                readF32Bits(p + 12, &m.lights[l].height);
+                readF32Bits(p + 16, &m.lights[l].radius);
+                readF32Bits(p + 20, &m.lights[l].intensity);
+            }
+            m.lightCount = count;
+        }
+        pos += size;
+    }
+    free(data);
+
+    if (!haveTiles) {
+        printf("Map file %s has no tile layer\n", path);
+        freeMap(&m);
+        return false;
+    }
+    if (!haveDistField) {
+        buildDistanceField(&m);
+    }
+    m.hash = hashTiles(&m);
+    *out = m;
+    return true;
+}
+
+// Append one RLE layer at pos, falling back to raw storage if RLE doesn't help
+size_t writeLayer(Uint8* dst, int type, const Uint8* src, size_t size) {
+    size_t encoded = rleEncode(src, size, dst + LAYER_HEADER_SIZE, size);
+    int encoding = ENCODING_RLE;
+    if (encoded >= size) {
+        memcpy(dst + LAYER_HEADER_SIZE, src, size);
+        encoded = size;
+        encoding = ENCODING_RAW;
+    }
+    dst[0] = type;
+    dst[1] = encoding;
+    writeU16(dst + 2, 0);
+    writeU32(dst + 4, encoded);
+    return LAYER_HEADER_SIZE + encoded;
+}
+
+bool saveMapFile(const char* path, Map* m) {
+    size_t layerSize = (size_t)m->width * m->height;
+    // writeLayer never stores more than the raw layer
+    size_t maxLayer = LAYER_HEADER_SIZE + layerSize;
+    Uint8* data = malloc(MAP_HEADER_SIZE + 2 * maxLayer + LAYER_HEADER_SIZE + 4 + MAX_LIGHTS * LIGHT_RECORD_SIZE);
+    if (data == NULL) {
+        printf("Not enough memory to save %s\n", path);
+        return false;
+    }
+
+    size_t pos = MAP_HEADER_SIZE;
+    pos += writeLayer(data + pos, LAYER_TILES, m->tiles, layerSize);
+    pos += writeLayer(data + pos, LAYER_DIST_FIELD, m->distField, layerSize);
+
+    Uint8* lightLayer = data + pos;
+    lightLayer[0] = LAYER_LIGHTS;
+    lightLayer[1] = ENCODING_RAW;
+    writeU16(lightLayer + 2, 0);
+    writeU32(lightLayer + 4, 4 + m->lightCount * LIGHT_RECORD_SIZE);
+    writeU32(lightLayer + 8, m->lightCount);
+    for (int l = 0; l < m->lightCount; l++) {
+        Uint8* p = lightLayer + 12 + l * LIGHT_RECORD_SIZE;
+        writeF32(p, m->lights[l].x);
+        writeF32(p + 4, m->lights[l].y);
+        writeF32(p + 8, m->lights[l].width);
+        writeF32(p + 12, m->lights[l].height);
+        writeF32(p + 16, m->lights[l].radius);
+        writeF32(p + 20, m->lights[l].intensity);
+    }
+    pos += LAYER_HEADER_SIZE + 4 + m->lightCount * LIGHT_RECORD_SIZE;
+
+    memcpy(data, MAP_MAGIC, 4);
+    writeU16(data + 4, MAP_VERSION);
+    writeU16(data + 6, 3);
+    writeU32(data + 8, m->width);
+    writeU32(data + 12, m->height);
+    writeU32(data + 16, crc32(data + MAP_HEADER_SIZE, pos - MAP_HEADER_SIZE));
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, pos, file) == pos;
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(data);
+    if (!ok) {
+        printf("Could not write map file %s\n", path);
+    }
+    return ok;
+}
+
+// Function to check for wall collision
+bool isWall(int x, int y) {
+    int mapX = x / TILE_SIZE;
+    int mapY = y / TILE_SIZE;
+    if (mapX >= 0 && mapX < map.width && mapY >= 0 && mapY < map.height) {
+        return getTile(mapX, mapY) == 1;
+    }
+    return false;
+}
+
+// Check if the player can move to the new position
+bool canMoveTo(Player* player, float deltaX, float deltaY) {
+    float newX = player->x + deltaX;
+    float newY = player->y + deltaY;
+    return !isWall(newX, newY);
+}
+
+// Advance the game by one tick. This is the only place input changes the world,
+// so feeding it the same TickInputs always produces the same game.
+void simulateTick(Player* player, TickInput* input) {
+    for (int i = 0; i < input->editCount; i++) {
+        int gridX = input->edits[i].x;
+        int gridY = input->edits[i].y;
+        if (gridX < map.width && gridY < map.height) {
+            // Toggle between wall (1) and empty (0)
+            setTile(gridX, gridY, (getTile(gridX, gridY) == 1) ? 0 : 1);
+        }
+    }
+
+    // Handle player movement
+    float speed = 2.0f;
+    if (input->buttons & INPUT_FORWARD) {
+        float deltaX = cos(player->angle * M_PI / 180) * speed;
+        float deltaY = sin(player->angle * M_PI / 180) * speed;
+        if (canMoveTo(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_BACK) {
+        float deltaX = -cos(player->angle * M_PI / 180) * speed;
+        float deltaY = -sin(player->angle * M_PI / 180) * speed;
+        if (canMoveTo(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_LEFT) {
+        player->angle -= 2.0f; // Rotate left
+    }
+    if (input->buttons & INPUT_RIGHT) {
+        player->angle += 2.0f; // Rotate right
+    }
+}
+
+// Hash of everything the simulation owns, compared between runs to prove that
+// a change didn't alter behaviour
+Uint64 stateHash(Player* player) {
+    Uint32 bits[3];
+    memcpy(&bits[0], &player->x, 4);
+    memcpy(&bits[1], &player->y, 4);
+    memcpy(&bits[2], &player->angle, 4);
+    Uint64 hash = map.hash;
+    for (int i = 0; i < 3; i++) {
+        hash = mixHash(hash ^ bits[i]);
+    }
+    return hash;
+}
+
+bool startRecording(InputRecorder* rec, const char* path, Player* player) {
+    rec->file = fopen(path, "wb");
+    rec->runLength = 0;
+    if (rec->file == NULL) {
+        printf("Could not create recording %s\n", path);
+        return false;
+    }
+    Uint8 header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, 4);
+    writeU16(header + 4, RECORD_VERSION);
+    writeU16(header + 6, 0);
+    writeU32(header + 8, crc32(map.tiles, (size_t)map.width * map.height));
+    writeF32(header + 12, player->x);
+    writeF32(header + 16, player->y);
+    writeF32(header + 20, player->angle);
+    fwrite(header, 1, RECORD_HEADER_SIZE, rec->file);
+    return true;
+}
+
+void flushRecordRun(InputRecorder* rec) {
+    if (rec->runLength > 0) {
+        Uint8 record[2] = { rec->buttons, (Uint8)rec->runLength };
+        fwrite(record, 1, 2, rec->file);
+        rec->runLength = 0;
+    }
+}
+
+void recordTick(InputRecorder* rec, TickInput* input) {
+    if (input->editCount == 0) {
+        if (rec->runLength > 0 && (rec->buttons != input->buttons || rec->runLength == 255)) {
+            flushRecordRun(rec);
+        }
+        rec->buttons = input->buttons;
+        rec->runLength++;
+        return;
+    }
+
+    flushRecordRun(rec);
+    Uint8 record[3 + MAX_TICK_EDITS * 4];
+    record[0] = input->buttons | RECORD_HAS_EDITS;
+    record[1] = 1;
+    record[2] = input->editCount;
+    for (int i = 0; i < input->editCount; i++) {
+        writeU16(record + 3 + i * 4, input->edits[i].x);
+        writeU16(record + 5 + i * 4, input->edits[i].y);
+    }
+    fwrite(record, 1, 3 + input->editCount * 4, rec->file);
+}
+
+void stopRecording(InputRecorder* rec) {
+    flushRecordRun(rec);
+    fclose(rec->file);
+    rec->file = NULL;
+}
+
+bool openReplay(InputReplay* replay, const char* path, Player* player) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open recording %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    replay->data = size > 0 ? malloc(size) : NULL;
+    if (replay->data == NULL || fread(replay->data, 1, size, file) != (size_t)size) {
+        printf("Could not read recording %s\n", path);
+        free(replay->data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    if (size < RECORD_HEADER_SIZE || memcmp(replay->data, RECORD_MAGIC, 4) != 0 || readU16(replay->data + 4) != RECORD_VERSION) {
+        printf("%s is not a version %d recording\n", path, RECORD_VERSION);
+        free(replay->data);
+        return false;
+    }
+    if (readU32(replay->data + 8) != crc32(map.tiles, (size_t)map.width * map.height)) {
+        printf("Warning: %s was recorded on a different map\n", path);
+    }
+    readF32Bits(replay->data + 12, &player->x);
+    readF32Bits(replay->data + 16, &player->y);
+    readF32Bits(replay->data + 20, &player->angle);
+    replay->size = size;
+    replay->pos = RECORD_HEADER_SIZE;
+    replay->runLeft = 0;
+    return true;
+}
+
+// Fill in the next tick from the recording; returns false once it runs out
+bool replayTick(InputReplay* replay, TickInput* input) {
+    input->editCount = 0;
+    if (replay->runLeft > 0) {
+        input->buttons = replay->buttons;
+        replay->runLeft--;
+        return true;
+    }
+    if (replay->pos + 2 > replay->size) {
+        return false;
+    }
+
+    Uint8 buttons = replay->data[replay->pos];
+    int count = replay->data[replay->pos + 1];
+    replay->pos += 2;
+    input->buttons = buttons & ~RECORD_HAS_EDITS;
+    if (buttons & RECORD_HAS_EDITS) {
+        if (replay->pos + 1 > replay->size) return false;
+        int editCount = replay->data[replay->pos++];
+        if (editCount > MAX_TICK_EDITS || replay->pos + editCount * 4 > replay->size) return false;
+        for (int i = 0; i < editCount; i++) {
+            input->edits[i].x = readU16(replay->data + replay->pos);
+            input->edits[i].y = readU16(replay->data + replay->pos + 2);
+            replay->pos += 4;
+        }
+        input->editCount = editCount;
+    }
+    replay->buttons = input->buttons;
+    replay->runLeft = count - 1;
+    return count > 0;
+}
+
+float castRayHit(Player* player, float rayAngle, RayHit* hit) {
+    float rayX = player->x;
+    float rayY = player->y;
+    float prevX = rayX;
+    float prevY = rayY;
+    float stepX = cos(rayAngle * M_PI / 180);
+    float stepY = sin(rayAngle * M_PI / 180);
+    float distance = 0;
+
+    while (!isWall(rayX, rayY) && distance < SCREEN_WIDTH) {
+        // A wall at least d tiles away (in both axes) leaves d - 1 whole tiles
+        // of open space, so the ray can jump across them in one step
+        int step = 1;
+        int mapX = (int)rayX / TILE_SIZE;
+        int mapY = (int)rayY / TILE_SIZE;
+        if (rayX >= 0 && rayY >= 0 && mapX < map.width && mapY < map.height) {
+            int d = map.distField[mapY * map.width + mapX];
+            if (d > 1) {
+                step = (d - 1) * TILE_SIZE;
+                if (distance + step > SCREEN_WIDTH) step = SCREEN_WIDTH - distance;
+                if (step < 1) step = 1;
+            }
+        }
+        prevX = rayX;
+        prevY = rayY;
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+    }
+
+    hit->distance = distance;
+    hit->mapX = -1;
+    if (isWall(rayX, rayY)) {
+        // The last step is always a single unit, so the tile it came from tells
+        // which face was crossed
+        int hitX = (int)rayX / TILE_SIZE;
+        int hitY = (int)rayY / TILE_SIZE;
+        int fromX = (int)prevX / TILE_SIZE;
+        hit->mapX = hitX;
+        hit->mapY = hitY;
+        if (fromX != hitX) {
+            hit->face = hitX > fromX ? 0 : 1;
+            hit->u = fmodf(rayY, TILE_SIZE) / TILE_SIZE;
+        } else {
+            hit->face = (int)rayY / TILE_SIZE > (int)prevY / TILE_SIZE ? 2 : 3;
+            hit->u = fmodf(rayX, TILE_SIZE) / TILE_SIZE;
+        }
+    }
+    return distance;
+}
+
+float castRay(Player* player, float rayAngle) {
+    RayHit hit;
+    return castRayHit(player, rayAngle, &hit);
+}
+
+int wallLight(RayHit* hit) {
+    if (map.lightCount == 0 || hit->mapX < 0) {
+        return 255;
+    }
+    int texel = (int)(hit->u * LIGHTMAP_FACE_RES);
+    if (texel >= LIGHTMAP_FACE_RES) texel = LIGHTMAP_FACE_RES - 1;
+    size_t tile = (size_t)hit->mapY * map.width + hit->mapX;
+    return lightmaps.wall[(tile * 4 + hit->face) * LIGHTMAP_FACE_RES + texel];
+}
+
+int floorLight(float x, float y) {
+    int tileX = (int)floorf(x / TILE_SIZE);
+    int tileY = (int)floorf(y / TILE_SIZE);
+    if (tileX < 0 || tileX >= map.width || tileY < 0 || tileY >= map.height) {
+        return AMBIENT_LIGHT;
+    }
+    int fx = (int)((x - tileX * TILE_SIZE) * LIGHTMAP_FLOOR_RES / TILE_SIZE);
+    int fy = (int)((y - tileY * TILE_SIZE) * LIGHTMAP_FLOOR_RES / TILE_SIZE);
+    size_t tile = (size_t)tileY * map.width + tileX;
+    return lightmaps.floor[tile * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES + fy * LIGHTMAP_FLOOR_RES + fx];
+}
+
+Uint32 rgb(int r, int g, int b) {
+    return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+// Fill the palette with 64-step ramps and draw the textures with it
+void buildPaletteAndTextures(void) {
+    for (int i = 0; i < 64; i++) {
+        palette[PALETTE_GREY + i] = rgb(i * 4, i * 4, i * 4);
+        palette[PALETTE_BRICK + i] = rgb(i * 4, i * 2, i * 3 / 2);
+        palette[PALETTE_FLOOR + i] = rgb(i * 100 / 63, i * 50 / 63, i * 50 / 63);
+        palette[PALETTE_CEILING + i] = rgb(i * 50 / 63, i * 50 / 63, i * 100 / 63);
+    }
+
+    // Bricks 32x16 with every other row offset by half a brick, 2px mortar
+    Uint32 seed = 12345;
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) % 12;
+            int bx = (x + ((y / 16) % 2) * 16) % 32;
+            bool mortar = (y % 16) < 2 || bx < 2;
+            wallTexture[x][y] = mortar ? PALETTE_GREY + 40 + noise / 2 : PALETTE_BRICK + 48 + noise;
+        }
+    }
+
+    // Large floor tiles with thin grout lines
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) % 6;
+            bool grout = (x % 32) == 0 || (y % 32) == 0;
+            bool dark = ((x / 32) + (y / 32)) % 2;
+            floorTexture[y][x] = grout ? PALETTE_GREY + 20 : PALETTE_FLOOR + (dark ? 50 : 60) + noise - 3;
+        }
+    }
+}
+
+// Precompute every palette colour at every light level. The number of levels is
+// the quality setting; the per-pixel cost is the same either way.
+void buildColormap(int levels) {
+    lightLevels = levels;
+    for (int l = 0; l < levels; l++) {
+        int scale = levels > 1 ? l * 256 / (levels - 1) : 256;
+        for (int c = 0; c < 256; c++) {
+            int r = ((palette[c] >> 16) & 0xFF) * scale >> 8;
+            int g = ((palette[c] >> 8) & 0xFF) * scale >> 8;
+            int b = (palette[c] & 0xFF) * scale >> 8;
+            colormap[l][c] = rgb(r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b);
+        }
+    }
+}
+
+int lightLevel(int light) {
+    return (light * (lightLevels - 1) + 127) / 255;
+}
+
+// Render the 3D view into a 32-bit ARGB buffer using textures and the colormap
+void renderIndexedView(Uint32* pixels, int pitch, Player* player) {
+    int stride = pitch / 4;
+    Uint32 ceiling = colormap[lightLevels - 1][PALETTE_CEILING + 63];
+
+    SDL_LockMutex(baker.lock);
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        RayHit hit;
+        float distance = castRayHit(player, rayAngle, &hit);
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+
+        // Keep the height finite when the camera is right up against a wall
+        float wallHeight = WALL_HEIGHT / ((distance > 1 ? distance : 1) * cosRel);
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+        int drawTop = wallTop < 0 ? 0 : wallTop;
+        int drawBottom = wallBottom > SCREEN_HEIGHT ? SCREEN_HEIGHT : wallBottom;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+        Uint32* cmap = colormap[lightLevel(shade * wallLight(&hit) / 255)];
+
+        Uint32* out = pixels + i;
+        for (int y = 0; y < drawTop; y++) {
+            out[y * stride] = ceiling;
+        }
+
+        // Wall: step down one texture column in 16.16 fixed point
+        int texX = hit.mapX >= 0 ? (int)(hit.u * TEXTURE_SIZE) & (TEXTURE_SIZE - 1) : 0;
+        Uint8* column = wallTexture[texX];
+        Uint32 texStep = (Uint32)(TEXTURE_SIZE * 65536.0f / (wallHeight > 1 ? wallHeight : 1));
+        Uint32 texPos = (Uint32)((drawTop - wallTop) * texStep);
+        for (int y = drawTop; y < drawBottom; y++) {
+            out[y * stride] = cmap[column[(texPos >> 16) & (TEXTURE_SIZE - 1)]];
+            texPos += texStep;
+        }
+
+        // Floor: project each row back onto the map for its texel and light
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        int floorTop = drawBottom < SCREEN_HEIGHT / 2 ? SCREEN_HEIGHT / 2 : drawBottom;
+        for (int y = drawBottom; y < floorTop; y++) {
+            out[y * stride] = ceiling;
+        }
+        for (int y = floorTop; y < SCREEN_HEIGHT; y++) {
+            float rowDistance = WALL_HEIGHT / (2 * (y + 0.5f - SCREEN_HEIGHT / 2) * cosRel);
+            float worldX = player->x + dirX * rowDistance;
+            float worldY = player->y + dirY * rowDistance;
+            int floorShade = 255 - (int)(rowDistance * 255 / SCREEN_WIDTH);
+            floorShade = floorShade < 0 ? 0 : floorShade;
+            int light = map.lightCount > 0 ? floorLight(worldX, worldY) : 255;
+            int tx = (int)worldX & (TEXTURE_SIZE - 1);
+            int ty = (int)worldY & (TEXTURE_SIZE - 1);
+            out[y * stride] = colormap[lightLevel(floorShade * light / 255)][floorTexture[ty][tx]];
+        }
+    }
+    SDL_UnlockMutex(baker.lock);
+}
+
+// Player marker and rays drawn on top of the 3D view
+void renderOverlay(SDL_Renderer* renderer, Player* player) {
+    // Render the player
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for player
+    SDL_Rect playerRect = { (int)(player->x - 5), (int)(player->y - 5), 10, 10 };
+    SDL_RenderFillRect(renderer, &playerRect);
+
+    // Render rays
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255); // Yellow for rays
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float distance = castRay(player, rayAngle);
+        float rayX = player->x + cos(rayAngle * M_PI / 180) * distance;
+        float rayY = player->y + sin(rayAngle * M_PI / 180) * distance;
+        SDL_RenderDrawLine(renderer, player->x, player->y, rayX, rayY);
+    }
+}
+
+void render3DView(SDL_Renderer* renderer, Player* player) {
+    // Keep the bake thread from publishing lightmaps halfway through a frame
+    SDL_LockMutex(baker.lock);
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        RayHit hit;
+        float distance = castRayHit(player, rayAngle, &hit);
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+
+        float wallHeight = WALL_HEIGHT / (distance * cosRel);
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+        shade = shade * wallLight(&hit) / 255;
+
+        // Render ceiling (roof)
+        SDL_SetRenderDrawColor(renderer, 50, 50, 100, 255);
+        SDL_RenderDrawLine(renderer, i, 0, i, wallTop);
+
+        // Render wall
+        SDL_SetRenderDrawColor(renderer, shade, shade, shade, 255);
+        SDL_RenderDrawLine(renderer, i, wallTop, i, wallBottom);
+
+        // Render floor
+        if (map.lightCount == 0) {
+            SDL_SetRenderDrawColor(renderer, 100, 50, 50, 255);
+            SDL_RenderDrawLine(renderer, i, wallBottom, i, SCREEN_HEIGHT);
+            continue;
+        }
+        // Project each floor row back onto the map and draw runs of rows that
+        // share a lightmap texel as one line
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        int runStart = wallBottom < SCREEN_HEIGHT / 2 ? SCREEN_HEIGHT / 2 : wallBottom;
+        int runLight = -1;
+        for (int y = runStart; y <= SCREEN_HEIGHT; y++) {
+            int light = runLight;
+            if (y < SCREEN_HEIGHT) {
+                float rowDistance = WALL_HEIGHT / (2 * (y + 0.5f - SCREEN_HEIGHT / 2) * cosRel);
+                light = floorLight(player->x + dirX * rowDistance, player->y + dirY * rowDistance);
+            }
+            if (light != runLight || y == SCREEN_HEIGHT) {
+                if (runLight >= 0) {
+                    SDL_SetRenderDrawColor(renderer, 100 * runLight / 255, 50 * runLight / 255, 50 * runLight / 255, 255);
+                    SDL_RenderDrawLine(renderer, i, runStart, i, y - 1);
+                }
+                runStart = y;
+                runLight = light;
+            }
+        }
+    }
+    SDL_UnlockMutex(baker.lock);
+
+    renderOverlay(renderer, player);
+}
+
+void renderMap(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) == 1) {
+                SDL_Rect wallRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                SDL_RenderFillRect(renderer, &wallRect);
+            }
+        }
+    }
+}
+
+void renderMapEditor(SDL_Renderer* renderer) {
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            SDL_Rect tileRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+            if (getTile(x, y) == 1) {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Wall (1) - Red
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Empty (0) - White
+            }
+            SDL_RenderFillRect(renderer, &tileRect);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black border
+            SDL_RenderDrawRect(renderer, &tileRect);
+        }
+    }
+}
+
+// Convert a rendered ARGB frame and write it out. Only integer math is used, so
+// the output is byte-exact no matter how fast the host is.
+bool writeFrame(VideoExport* ex, SDL_Surface* surface) {
+    int w = surface->w;
+    int h = surface->h;
+    Uint8* out = ex->convertBuffer;
+    size_t size;
+
+    if (ex->y4m) {
+        int cw = (w + 1) / 2;
+        int ch = (h + 1) / 2;
+        Uint8* planeY = out + 6;
+        Uint8* planeU = planeY + w * h;
+        Uint8* planeV = planeU + cw * ch;
+        memcpy(out, "FRAME\n", 6);
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+                planeY[y * w + x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            }
+        }
+        for (int cy = 0; cy < ch; cy++) {
+            for (int cx = 0; cx < cw; cx++) {
+                // Average the 2x2 block, clamping at odd edges
+                int r = 0, g = 0, b = 0;
+                for (int k = 0; k < 4; k++) {
+                    int x = cx * 2 + (k & 1);
+                    int y = cy * 2 + (k >> 1);
+                    if (x >= w) x = w - 1;
+                    if (y >= h) y = h - 1;
+                    Uint32 p = ((Uint32*)((Uint8*)surface->pixels + y * surface->pitch))[x];
+                    r += (p >> 16) & 0xFF;
+                    g += (p >> 8) & 0xFF;
+                    b += p & 0xFF;
+                }
+                r = (r + 2) >> 2;
+                g = (g + 2) >> 2;
+                b = (b + 2) >> 2;
+                planeU[cy * cw + cx] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+                planeV[cy * cw + cx] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+            }
+        }
+        size = 6 + (size_t)w * h + 2 * (size_t)cw * ch;
+    } else {
+        int header = sprintf((char*)out, "P6\n%d %d\n255\n", w, h);
+        Uint8* rgb = out + header;
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                *rgb++ = (row[x] >> 16) & 0xFF;
+                *rgb++ = (row[x] >> 8) & 0xFF;
+                *rgb++ = row[x] & 0xFF;
+            }
+        }
+        size = header + (size_t)w * h * 3;
+    }
+    return fwrite(out, 1, size, ex->file) == size;
+}
+
+int exportWriterThread(void* data) {
+    VideoExport* ex = data;
+    int slot = 0;
+    while (true) {
+        SDL_SemWait(ex->fullSlots);
+        ExportSlot* s = &ex->slots[slot];
+        bool last = s->last;
+        if (!s->empty && !ex->failed && !writeFrame(ex, s->surface)) {
+            ex->failed = true;
+        }
+        SDL_SemPost(ex->freeSlots);
+        slot = (slot + 1) % EXPORT_RING_SIZE;
+        if (last) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// Free what startExport made. Whatever it didn't get to is NULL.
+void freeExportBuffers(VideoExport* ex) {
+    for (int i = 0; i < EXPORT_RING_SIZE; i++) {
+        if (ex->slots[i].renderer != NULL) SDL_DestroyRenderer(ex->slots[i].renderer);
+        if (ex->slots[i].surface != NULL) SDL_FreeSurface(ex->slots[i].surface);
+    }
+    if (ex->freeSlots != NULL) SDL_DestroySemaphore(ex->freeSlots);
+    if (ex->fullSlots != NULL) SDL_DestroySemaphore(ex->fullSlots);
+    free(ex->convertBuffer);
+}
+
+bool startExport(VideoExport* ex, const char* path) {
+    size_t len = strlen(path);
+    ex->y4m = len > 4 && strcmp(path + len - 4, ".y4m") == 0;
+    ex->failed = false;
+    ex->file = fopen(path, "wb");
+    if (ex->file == NULL) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+    if (ex->y4m) {
+        fprintf(ex->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, EXPORT_FPS);
+    }
+    memset(ex->slots, 0, sizeof(ex->slots));
+    ex->freeSlots = NULL;
+    ex->fullSlots = NULL;
+    ex->convertBuffer = malloc(64 + (size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+    bool ok = ex->convertBuffer != NULL;
+    if (!ok) {
+        printf("Not enough memory to export\n");
+    }
+    for (int i = 0; ok && i < EXPORT_RING_SIZE; i++) {
+        ex->slots[i].surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        ex->slots[i].renderer = ex->slots[i].surface ? SDL_CreateSoftwareRenderer(ex->slots[i].surface) : NULL;
+        if (ex->slots[i].renderer == NULL) {
+            printf("Could not create offscreen renderer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (ok) {
+        ex->freeSlots = SDL_CreateSemaphore(EXPORT_RING_SIZE);
+        ex->fullSlots = SDL_CreateSemaphore(0);
+        ex->writer = NULL;
+        if (ex->freeSlots != NULL && ex->fullSlots != NULL) {
+            ex->writer = SDL_CreateThread(exportWriterThread, "export writer", ex);
+        }
+        if (ex->writer == NULL) {
+            printf("Could not start the export writer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (!ok) {
+        freeExportBuffers(ex);
+        fclose(ex->file);
+        return false;
+    }
+    return true;
+}
+
+// Grab the next free ring slot, blocking only if the writer is a full ring behind
+ExportSlot* beginExportFrame(VideoExport* ex, int frame) {
+    SDL_SemWait(ex->freeSlots);
+    return &ex->slots[frame % EXPORT_RING_SIZE];
+}
+
+void endExportFrame(VideoExport* ex, ExportSlot* slot, bool last) {
+    slot->last = last;
+    SDL_SemPost(ex->fullSlots);
+}
+
+// Let the writer finish without handing it another frame
+void stopExport(VideoExport* ex, int frame) {
+    ExportSlot* slot = beginExportFrame(ex, frame);
+    slot->empty = true;
+    endExportFrame(ex, slot, true);
+}
+
+bool finishExport(VideoExport* ex) {
+    SDL_WaitThread(ex->writer, NULL);
+    freeExportBuffers(ex);
+    if (fclose(ex->file) != 0) {
+        ex->failed = true;
+    }
+    return !ex->failed;
+}
+
+void renderExportFrame(ExportSlot* slot, Player* player) {
+    if (indexedMode) {
+        renderIndexedView(slot->surface->pixels, slot->surface->pitch, player);
+        renderOverlay(slot->renderer, player);
+    } else {
+        SDL_SetRenderDrawColor(slot->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(slot->renderer);
+        render3DView(slot->renderer, player);
+    }
+}
+
+// Camera path files have one "frame x y angle" keyframe per line
+int loadCameraPath(const char* path, PathKey* keys) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Could not open camera path %s\n", path);
+        return 0;
+    }
+    int count = 0;
+    PathKey key;
+    while (count < MAX_PATH_KEYS && fscanf(file, "%d %f %f %f", &key.frame, &key.pose.x, &key.pose.y, &key.pose.angle) == 4) {
+        if (count > 0 && key.frame <= keys[count - 1].frame) {
+            printf("Camera path %s: keyframes must be in increasing frame order\n", path);
+            fclose(file);
+            return 0;
+        }
+        keys[count++] = key;
+    }
+    fclose(file);
+    if (count == 0) {
+        printf("Camera path %s has no keyframes\n", path);
+    }
+    return count;
+}
+
+void cameraPathPose(PathKey* keys, int count, int frame, Player* pose) {
+    int k = 0;
+    while (k + 1 < count && keys[k + 1].frame <= frame) k++;
+    if (k + 1 >= count || frame <= keys[k].frame) {
+        *pose = keys[k].pose;
+        return;
+    }
+    float t = (float)(frame - keys[k].frame) / (keys[k + 1].frame - keys[k].frame);
+    pose->x = keys[k].pose.x + (keys[k + 1].pose.x - keys[k].pose.x) * t;
+    pose->y = keys[k].pose.y + (keys[k + 1].pose.y - keys[k].pose.y) * t;
+    pose->angle = keys[k].pose.angle + (keys[k + 1].pose.angle - keys[k].pose.angle) * t;
+}
+
+// Render a replay or camera path to a video file without opening any windows
+int runExport(const char* exportPath, InputReplay* replay, const char* pathFile, Player* player) {
+    static PathKey keys[MAX_PATH_KEYS];
+    int keyCount = 0;
+    if (pathFile != NULL) {
+        keyCount = loadCameraPath(pathFile, keys);
+        if (keyCount == 0) return 1;
+    }
+
+    VideoExport ex;
+    if (!startExport(&ex, exportPath)) {
+        return 1;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    int frame = 0;
+    bool more = true;
+    TickInput input;
+    while (more) {
+        if (replay->data != NULL) {
+            if (!replayTick(replay, &input)) {
+                // Past the first frame this only happens on a cut-off or
+                // damaged replay, whose last frame wasn't flagged
+                break;
+            }
+            simulateTick(player, &input);
+            // Peek ahead so the final frame can be flagged for the writer
+            more = replay->runLeft > 0 || replay->pos + 2 <= replay->size;
+        } else {
+            cameraPathPose(keys, keyCount, frame, player);
+            more = frame < keys[keyCount - 1].frame;
+        }
+
+        ExportSlot* slot = beginExportFrame(&ex, frame);
+        renderExportFrame(slot, player);
+        endExportFrame(&ex, slot, !more);
+        frame++;
+    }
+    bool cutOff = more && frame > 0;
+    if (cutOff) {
+        stopExport(&ex, frame);
+    }
+    if (frame == 0) {
+        // Empty replay: still hand the writer a frame so it can exit
+        ExportSlot* slot = beginExportFrame(&ex, 0);
+        renderExportFrame(slot, player);
+        endExportFrame(&ex, slot, true);
+        frame = 1;
+    }
+
+    bool ok = finishExport(&ex);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    if (!ok) {
+        printf("Writing %s failed\n", exportPath);
+        return 1;
+    }
+    if (cutOff) {
+        printf("The replay is cut off or damaged, only its first %d frames went to %s\n", frame, exportPath);
+        return 1;
+    }
+    printf("Exported %d frames to %s in %.2f s (%.1f fps)\n", frame, exportPath, seconds, frame / seconds);
+    return 0;
+}
+
+// Move the player to the first open tile if the start position is inside a wall
+void placePlayer(Player* player) {
+    if (!isWall(player->x, player->y)) return;
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) != 1) {
+                player->x = x * TILE_SIZE + TILE_SIZE / 2;
+                player->y = y * TILE_SIZE + TILE_SIZE / 2;
+                return;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: raycastv-4.07 [map.rcm] [--record file.rcr | --replay file.rcr] [--hashes file.txt]
+    //                     [--export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)]
+    //                     [--indexed] [--light-levels n]
+    // F3 switches between the solid colour and indexed colour (textured) views.
+    // F2 saves the (edited) map to the same file, or to map.rcm by default.
+    const char* mapPath = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* hashPath = NULL;
+    const char* exportPath = NULL;
+    const char* cameraPath = NULL;
+    int levels = DEFAULT_LIGHT_LEVELS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--hashes") == 0 && i + 1 < argc) {
+            hashPath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            cameraPath = argv[++i];
+        } else if (strcmp(argv[i], "--indexed") == 0) {
+            indexedMode = true;
+        } else if (strcmp(argv[i], "--light-levels") == 0 && i + 1 < argc) {
+            levels = atoi(argv[++i]);
+            if (levels < 2 || levels > MAX_LIGHT_LEVELS) {
+                printf("--light-levels must be between 2 and %d\n", MAX_LIGHT_LEVELS);
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && mapPath == NULL) {
+            mapPath = argv[i];
+        } else {
+            printf("Usage: %s [map.rcm] [--record file.rcr | --replay file.rcr] [--hashes file.txt]\n", argv[0]);
+            printf("       %s [map.rcm] --export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)\n", argv[0]);
+            printf("       add --indexed for the textured indexed colour view, --light-levels n to set its shading steps\n");
+            return 1;
+        }
+    }
+    if (exportPath != NULL && (replayPath == NULL) == (cameraPath == NULL)) {
+        printf("--export needs exactly one of --replay or --path\n");
+        return 1;
+    }
+    if (mapPath != NULL) {
+        if (!loadMapFile(mapPath, &map)) {
+            return 1;
+        }
+    } else {
+        mapPath = "map.rcm";
+        loadDefaultMap(&map);
+    }
+    if (!allocLightmaps(&lightmaps, map.width, map.height)) {
+        printf("Not enough memory for lightmaps\n");
+        return 1;
+    }
+    bakeAllLightmaps();
+    buildPaletteAndTextures();
+    buildColormap(levels);
+    // Exports must come out the same every time, so they rebake in line
+    startLightBaker(exportPath != NULL);
+
+    if (exportPath != NULL) {
+        Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+        placePlayer(&player);
+        InputReplay replay = { NULL };
+        if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+            return 1;
+        }
+        int result = runExport(exportPath, &replay, cameraPath, &player);
+        free(replay.data);
+        stopLightBaker();
+        freeLightmaps(&lightmaps);
+        freeMap(&map);
+        return result;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Create main game window
+    SDL_Window* mainWindow = SDL_CreateWindow("Raycasting Game",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    // Create 3D view window
+    SDL_Window* viewWindow = SDL_CreateWindow("3D View",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    SDL_Renderer* viewRenderer = SDL_CreateRenderer(viewWindow, -1, SDL_RENDERER_ACCELERATED);
+    SDL_Texture* viewTexture = SDL_CreateTexture(viewRenderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    // Create map editor window
+    SDL_Window* editorWindow = SDL_CreateWindow("Map Editor",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, map.width * TILE_SIZE, map.height * TILE_SIZE, SDL_WINDOW_SHOWN);
+    SDL_Renderer* editorRenderer = SDL_CreateRenderer(editorWindow, -1, SDL_RENDERER_ACCELERATED);
+
+    Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+    placePlayer(&player);
+
+    InputRecorder recorder = { NULL };
+    InputReplay replay = { NULL };
+    FILE* hashFile = NULL;
+    if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+        return 1;
+    }
+    if (recordPath != NULL && !startRecording(&recorder, recordPath, &player)) {
+        return 1;
+    }
+    if (hashPath != NULL) {
+        hashFile = fopen(hashPath, "w");
+        if (hashFile == NULL) {
+            printf("Could not create hash log %s\n", hashPath);
+            return 1;
+        }
+    }
+
+    bool quit = false;
+    const Uint8* keystate;
+    SDL_Event e;
+    TickInput input;
+    Uint32 tick = 0;
+
+    while (!quit) {
+        input.editCount = 0;
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            // Save the map
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2) {
+                if (saveMapFile(mapPath, &map)) {
+                    printf("Saved map to %s\n", mapPath);
+                }
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+                indexedMode = !indexedMode;
+            }
+            // Map editor mouse click handling
+            if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && replay.data == NULL) {
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+                int gridX = mouseX / TILE_SIZE;
+                int gridY = mouseY / TILE_SIZE;
+                if (gridX >= 0 && gridX < map.width && gridY >= 0 && gridY < map.height && input.editCount < MAX_TICK_EDITS) {
+                    input.edits[input.editCount].x = gridX;
+                    input.edits[input.editCount].y = gridY;
+                    input.editCount++;
+                }
+            }
+        }
+        if (quit) {
+            break;
+        }
+
+        if (replay.data != NULL) {
+            // The recording replaces the keyboard and mouse entirely
+            if (!replayTick(&replay, &input)) {
+                break;
+            }
+        } else {
+            keystate = SDL_GetKeyboardState(NULL);
+            input.buttons = 0;
+            if (keystate[SDL_SCANCODE_W]) input.buttons |= INPUT_FORWARD;
+            if (keystate[SDL_SCANCODE_S]) input.buttons |= INPUT_BACK;
+            if (keystate[SDL_SCANCODE_A]) input.buttons |= INPUT_LEFT;
+            if (keystate[SDL_SCANCODE_D]) input.buttons |= INPUT_RIGHT;
+        }
+
+        if (recorder.file != NULL) {
+            recordTick(&recorder, &input);
+        }
+        simulateTick(&player, &input);
+        tick++;
+        if (hashFile != NULL) {
+            fprintf(hashFile, "%u %016llx\n", tick, (unsigned long long)stateHash(&player));
+        }
+
+        // Render the 3D view
+        SDL_SetRenderDrawColor(viewRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(viewRenderer);
+        if (indexedMode) {
+            void* pixels;
+            int pitch;
+            if (SDL_LockTexture(viewTexture, NULL, &pixels, &pitch) == 0) {
+                renderIndexedView(pixels, pitch, &player);
+                SDL_UnlockTexture(viewTexture);
+            }
+            SDL_RenderCopy(viewRenderer, viewTexture, NULL, NULL);
+            renderOverlay(viewRenderer, &player);
+        } else {
+            render3DView(viewRenderer, &player);
+        }
+        SDL_RenderPresent(viewRenderer);
+
+        // Render the main game window
+        SDL_SetRenderDrawColor(mainRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(mainRenderer);
+        renderMap(mainRenderer);
+        SDL_RenderPresent(mainRenderer);
+
+        // Render the map editor
+        SDL_SetRenderDrawColor(editorRenderer, 255, 255, 255, 255);
+        SDL_RenderClear(editorRenderer);
+        renderMapEditor(editorRenderer);
+        SDL_RenderPresent(editorRenderer);
+    }
+
+    SDL_DestroyRenderer(mainRenderer);
+    SDL_DestroyWindow(mainWindow);
+    SDL_DestroyTexture(viewTexture);
+    SDL_DestroyRenderer(viewRenderer);
+    SDL_DestroyWindow(viewWindow);
+    SDL_DestroyRenderer(editorRenderer);
+    SDL_DestroyWindow(editorWindow);
+    SDL_Quit();
+
+    if (recorder.file != NULL) {
+        stopRecording(&recorder);
+    }
+    if (hashFile != NULL) {
+        fclose(hashFile);
+    }
+    if (replay.data != NULL) {
+        printf("Replayed %u ticks, final state hash %016llx\n", tick, (unsigned long long)stateHash(&player));
+        free(replay.data);
+    }
+    stopLightBaker();
+    freeLightmaps(&lightmaps);
+    freeMap(&map);
+
+    return 0;
+}
@@ -0,0 +1,3281 @@
+#include <SDL2/SDL.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define FOV 60
+#define NUM_RAYS SCREEN_WIDTH
+#define TILE_SIZE 64
+#define MAP_WIDTH 10   // Size of the built-in map used when no map file is given
+#define MAP_HEIGHT 8
+#define WALL_HEIGHT 4000  // Set wall height to 4000 for taller walls
+
+#define MAX_MAP_SIDE 65536  // Largest map width/height a map file may declare
+#define MAX_DIST_FIELD 255  // Distance field values are stored in one byte
+
+// Map file format (.rcm), all numbers little-endian:
+//   header:  "RCMP", u16 version, u16 layer count, u32 width, u32 height,
+//            u32 CRC32 of everything after the header
+//   layers:  u8 type, u8 encoding, u16 reserved, u32 encoded size, data
+// Tile layers hold width * height bytes once decoded; the light layer holds a
+// u32 count and then x, y, width, height, radius, intensity as f32 per light.
+// Unknown layer types are skipped so newer files still open in older versions.
+#define MAP_MAGIC "RCMP"
+#define MAP_VERSION 1
+#define MAP_HEADER_SIZE 20
+#define LAYER_HEADER_SIZE 8
+#define LAYER_TILES 1
+#define LAYER_DIST_FIELD 2  // Precomputed so loading doesn't have to rebuild it
+#define LAYER_LIGHTS 3
+#define LAYER_HEIGHTS 4  // Wall height per tile, in eighths of a standard wall
+#define LAYER_FLOORS 5   // Floor elevation per tile, in eighths of a standard wall
+#define LIGHT_RECORD_SIZE 24
+#define ENCODING_RAW 0
+#define ENCODING_RLE 1
+
+// Input recording format (.rcr), little-endian:
+//   header:  "RCRP", u16 version, u16 reserved, u32 CRC32 of the map tiles,
+//            f32 start x, f32 start y, f32 start angle
+//   records: u8 buttons, u8 tick count, and when RECORD_HAS_EDITS is set,
+//            u8 edit count followed by u16 x, u16 y per toggled tile
+// Ticks without edits are run-length merged, so holding a key costs 2 bytes
+// per 255 ticks.
+// Version 2 added INPUT_TERRAIN.
+#define RECORD_MAGIC "RCRP"
+#define RECORD_VERSION 2
+#define RECORD_HEADER_SIZE 24
+#define RECORD_HAS_EDITS 0x80
+
+#define INPUT_FORWARD 1
+#define INPUT_BACK 2
+#define INPUT_LEFT 4
+#define INPUT_RIGHT 8
+#define INPUT_TERRAIN 32  // The terrain view was on, which has no walls to bump into
+#define MAX_TICK_EDITS 32
+
+// Offscreen export: frames are rendered into a ring of preallocated surfaces and
+// a writer thread converts and writes them while the next frame renders
+#define EXPORT_RING_SIZE 4
+#define EXPORT_FPS 60
+#define MAX_PATH_KEYS 1024
+
+// Static lighting is baked into lightmaps that the renderer only has to look up
+#define MAX_LIGHTS 64
+#define LIGHTMAP_FACE_RES 8   // Texels along each wall face
+#define LIGHTMAP_FLOOR_RES 4  // Texels along each side of a floor tile
+#define AMBIENT_LIGHT 48
+#define AREA_LIGHT_SAMPLES 3  // Area lights are baked as a 3x3 grid of point lights
+#define MAX_LIGHT_JOBS 64
+
+// Indexed colour mode: 8-bit textures and a colormap of light level x palette
+// index, so shading a pixel is one table lookup
+#define TEXTURE_SIZE 64
+#define MAX_LIGHT_LEVELS 256
+#define DEFAULT_LIGHT_LEVELS 32
+#define PALETTE_GREY 0      // 64-entry ramps in the palette
+#define PALETTE_BRICK 64
+#define PALETTE_FLOOR 128
+#define PALETTE_CEILING 192
+
+// Variable-height mode: every tile is a block from the ground up to its floor
+// elevation (open tiles) or floor elevation plus wall height (walls)
+#define HEIGHT_UNITS 8          // Heights are stored in eighths of a standard wall
+#define DEFAULT_WALL_HEIGHT 8
+#define EYE_HEIGHT 0.5f         // The camera sits halfway up a standard wall
+#define MAX_VIEW_DISTANCE 2048  // Rays that still see open sky stop here
+
+// Terrain mode: a heightmap and colour map drawn column by column, front to
+// back, with a y-buffer. Terrain texels are one world unit apart and wrap.
+#define TERRAIN_SIZE 1024        // Generated terrain size, a power of two
+#define TERRAIN_DISTANCE 3000    // How far the terrain is drawn
+#define TERRAIN_LOD 0.004f       // Sample step grows by this much per unit of distance
+#define TERRAIN_CAMERA_HEIGHT 40 // Camera height above the ground under the player
+#define TERRAIN_SCALE 240        // Vertical projection scale
+
+// Threaded mode: the simulation runs on a thread of its own at a fixed rate and
+// hands snapshots to the main thread through a lock-free triple buffer
+#define SIM_TICK_RATE 60
+#define EDIT_QUEUE_SIZE 65536  // Power of two
+#define EVENT_QUEUE_SIZE 1024  // Power of two
+#define SNAPSHOT_FRESH 4       // Set in the triple buffer state while a new snapshot waits
+
+// --watch reloads the map when it changes on disk, comparing it in chunks of
+// RELOAD_CHUNK x RELOAD_CHUNK tiles so only changed chunks are patched
+#define RELOAD_CHUNK 16
+
+// Adaptive ray casting: cast every RAY_STEP-th column, then fill in spans whose
+// ends hit the same wall plane without casting. Spans are at most 32 columns so
+// no tile can hide between their edge rays inside the view distance.
+#define RAY_STEP 8
+#define MAX_RAY_STEP 32
+#define RAY_GUARD 0.05  // Interpolated hits this close to a rounding edge are cast instead
+
+typedef struct {
+    float x, y;
+    float angle;
+} Player;
+
+typedef struct {
+    float x, y;           // Centre in world units
+    float width, height;  // 0 for a point light, otherwise the size of an area light
+    float radius;         // Light falls off linearly to nothing at this distance
+    float intensity;      // Light level added right next to the light (0-255)
+} Light;
+
+typedef struct {
+    int width, height;
+    Uint8* tiles;      // width * height tiles, row-major, 1 is a wall
+    Uint8* distField;  // Distance in tiles to the nearest wall (8-neighbour), 0 on walls
+    Uint64 hash;       // Hash of all tiles, updated by setTile on every edit
+    Uint8* heights;    // Wall height per tile in HEIGHT_UNITS
+    Uint8* floors;     // Floor elevation per tile in HEIGHT_UNITS
+    int maxTop;        // Never lower than the tallest block, for ending rays early
+    Light lights[MAX_LIGHTS];
+    int lightCount;    // No lights means the map is drawn fully lit
+} Map;
+
+typedef struct {
+    int x0, y0, x1, y1;  // Tiles x0 <= x < x1, y0 <= y < y1
+} TileRect;
+
+// Where a ray stopped; mapX is -1 when it ran out of range without hitting a wall
+typedef struct {
+    float distance;
+    int mapX, mapY;
+    int face;   // 0 west, 1 east, 2 north, 3 south, same order as the lightmaps
+    float u;    // Position along the face, 0-1
+} RayHit;
+
+// Read-only view of the tiles inside rect, so the bake thread can work on a
+// private copy while the editor keeps changing the real map
+typedef struct {
+    TileRect rect;
+    const Uint8* tiles;
+} TileView;
+
+// Light levels (0-255) for every wall face and floor tile
+typedef struct {
+    Uint8* wall;   // Per tile: 4 faces (west, east, north, south) * LIGHTMAP_FACE_RES
+    Uint8* floor;  // Per tile: LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES, row-major
+} Lightmaps;
+
+typedef struct {
+    TileRect rect;     // Tiles to rebake
+    TileView view;     // Snapshot of every tile a light reaching rect can see
+    Uint8* wall;       // Results for rect, copied into the live lightmaps when done
+    Uint8* floor;
+    Light lights[MAX_LIGHTS];  // The lights when the job was queued, as a reload can change them
+    int lightCount;
+} LightJob;
+
+// Background rebaking after editor changes
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* lock;     // Guards the queue and the live lightmaps
+    SDL_cond* changed;
+    LightJob* jobs[MAX_LIGHT_JOBS];
+    int head, count;
+    bool quit;
+    bool synchronous;    // Bake on the caller instead, for byte-exact exports
+} LightBaker;
+
+// Simple 2D map where 1 represents a wall and 0 is empty space
+int defaultMap[MAP_HEIGHT][MAP_WIDTH] = {
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 1, 0, 0, 1},
+    {1, 0, 0, 0, 0, 1, 1, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 1, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
+};
+
+typedef struct {
+    Uint16 x, y;
+} TileEdit;
+
+// Everything the simulation reads from the user during one tick
+typedef struct {
+    Uint8 buttons;
+    int editCount;
+    TileEdit edits[MAX_TICK_EDITS];
+} TickInput;
+
+typedef struct {
+    FILE* file;
+    Uint8 buttons;  // Pending run of edit-free ticks
+    int runLength;
+} InputRecorder;
+
+typedef struct {
+    Uint8* data;
+    size_t size;
+    size_t pos;
+    Uint8 buttons;  // Current run being played back
+    int runLeft;
+} InputReplay;
+
+// One camera path keyframe; poses in between are interpolated linearly
+typedef struct {
+    int frame;
+    Player pose;
+} PathKey;
+
+typedef struct {
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;
+    bool last;  // Set on the final frame so the writer knows to stop
+    bool empty; // No frame in it, only there to stop the writer
+} ExportSlot;
+
+typedef struct {
+    FILE* file;
+    bool y4m;            // YUV4MPEG2 4:2:0, otherwise a sequence of binary PPMs
+    Uint8* convertBuffer;
+    ExportSlot slots[EXPORT_RING_SIZE];
+    SDL_sem* freeSlots;
+    SDL_sem* fullSlots;
+    SDL_Thread* writer;
+    bool failed;
+} VideoExport;
+
+typedef struct {
+    bool indexed, heights, terrain, adaptiveRays;
+} ViewModes;
+
+// Everything the main thread needs to draw one simulation tick
+typedef struct {
+    Player player;
+    Uint32 tick;
+    Uint32 mapVersion;    // Number of map edits made up to this tick
+    Uint32 saveRequests;  // Bumped by F2; the main thread owns the full map and saves it
+    ViewModes modes;
+    bool quit;
+} Snapshot;
+
+// Lock-free triple buffer: the simulation always owns a back slot, the render
+// thread a front slot, and the middle slot is swapped atomically with either,
+// so neither side ever waits for the other
+typedef struct {
+    Snapshot slots[3];
+    SDL_atomic_t middle;  // Index of the middle slot, plus SNAPSHOT_FRESH
+    int back;             // Simulation only
+    int front;            // Main thread only
+} TripleBuffer;
+
+typedef struct {
+    Uint16 x, y;
+    Uint8 value;
+    Uint32 version;  // mapVersion after this edit
+    Map* reload;     // A reloaded map to diff in instead of one tile, freed once applied
+} QueuedEdit;
+
+// Single-producer single-consumer ring of map edits; both ends are wait-free
+typedef struct {
+    QueuedEdit edits[EDIT_QUEUE_SIZE];
+    SDL_atomic_t head;  // Next edit to apply, written by the main thread
+    SDL_atomic_t tail;  // Next free entry, written by the simulation
+} EditQueue;
+
+// Map changes that found editQueue full, because the main thread fell behind.
+// Until they are through, later changes wait here as well so nothing arrives
+// out of order.
+typedef struct {
+    TileRect rect;  // Tiles to send again from simMap, empty if none
+    int x, y;       // Next tile of rect to send
+    Map* reload;    // The newest reloaded map, sent before the tiles
+} EditBacklog;
+
+typedef struct {
+    int fd;          // inotify descriptor, -1 when not watching
+    char name[256];  // Name of the map file inside the watched directory
+} MapWatch;
+
+typedef struct {
+    SDL_Renderer* mainRenderer;
+    SDL_Renderer* viewRenderer;
+    SDL_Renderer* editorRenderer;
+    SDL_Texture* viewTexture;
+} RenderTargets;
+
+// Events the main thread passes on to the simulation thread under --threaded,
+// one producer and one consumer like EditQueue. The simulation keeps its own
+// key and mouse state from them, since SDL's belongs to the main thread.
+typedef struct {
+    SDL_Event events[EVENT_QUEUE_SIZE];
+    SDL_atomic_t head;  // Next event to handle, written by the simulation
+    SDL_atomic_t tail;  // Next free entry, written by the main thread
+    bool active;        // Set under --threaded, otherwise events come straight from SDL
+    Uint8 keys[SDL_NUM_SCANCODES];
+    SDL_Keymod mods;
+    int mouseX, mouseY;
+} EventQueue;
+
+Map map;
+Lightmaps lightmaps;
+LightBaker baker;
+
+bool indexedMode = false;
+bool heightMode = false;
+bool terrainMode = false;
+bool adaptiveRays = false;
+int rayStep = RAY_STEP;
+float rayTolerance = 0;  // Wall height error in pixels allowed for interpolated columns
+
+typedef struct {
+    int size;         // Width and height, a power of two
+    Uint8* height;
+    Uint32* color;    // ARGB
+} Terrain;
+
+Terrain terrain;
+
+// The map the simulation collides with and edits. It is the real map unless
+// --threaded is given, in which case the main thread owns the real map and
+// the simulation keeps a tiles-only copy, sending its edits over editQueue.
+Map* simMap = &map;
+Map collisionMap;
+EditQueue editQueue;
+EditBacklog editBacklog;
+EventQueue eventQueue;
+TripleBuffer snapshots;
+Uint32 mapVersion = 0;
+int lightLevels = DEFAULT_LIGHT_LEVELS;
+Uint32 palette[256];
+Uint32 colormap[MAX_LIGHT_LEVELS][256];
+Uint8 wallTexture[TEXTURE_SIZE][TEXTURE_SIZE];   // Indexed as [x][y] so a wall column is contiguous
+Uint8 floorTexture[TEXTURE_SIZE][TEXTURE_SIZE];  // Indexed as [y][x]
+
+// Default lights for the built-in map: one bulb and one ceiling panel
+Light defaultLights[] = {
+    { 288, 96, 0, 0, 320, 220 },
+    { 480, 352, 64, 32, 256, 180 }
+};
+
+int getTile(int x, int y) {
+    return map.tiles[y * map.width + x];
+}
+
+Uint64 mixHash(Uint64 v) {
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+}
+
+// Per-tile terms are XORed together so a single edit can be patched in O(1)
+Uint64 tileHash(size_t index, int value) {
+    return value == 0 ? 0 : mixHash(((Uint64)index << 8) | value);
+}
+
+Uint64 hashTiles(Map* m) {
+    Uint64 hash = 0;
+    size_t count = (size_t)m->width * m->height;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= tileHash(i, m->tiles[i]);
+    }
+    return hash;
+}
+
+// Rebuild the distance field with a two-pass chamfer sweep. Every step costs 1,
+// so the result is the exact Chebyshev distance to the nearest wall tile.
+void buildDistanceField(Map* m) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = w - 1; x >= 0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+// Patch the distance field after the tiles in rect changed. Outside rect only
+// cells whose nearest wall could be inside rect can change; going out ring by
+// ring, the first ring where every cell is closer to some other wall than to
+// rect bounds them. Everything inside that ring is swept again with the ring
+// as fixed boundary values.
+void updateDistanceField(Map* m, TileRect rect) {
+    int w = m->width;
+    int h = m->height;
+    Uint8* d = m->distField;
+
+    int r = 1;
+    for (;; r++) {
+        int x0 = rect.x0 - r, y0 = rect.y0 - r, x1 = rect.x1 + r - 1, y1 = rect.y1 + r - 1;
+        if (x0 < 0 && y0 < 0 && x1 >= w && y1 >= h) {
+            buildDistanceField(m);
+            return;
+        }
+        bool bounded = true;
+        for (int y = y0 > 0 ? y0 : 0; y <= y1 && y < h && bounded; y++) {
+            if (y == y0 || y == y1) {
+                for (int x = x0 > 0 ? x0 : 0; x <= x1 && x < w; x++) {
+                    if (d[y * w + x] >= r) bounded = false;
+                }
+            } else {
+                if (x0 >= 0 && d[y * w + x0] >= r) bounded = false;
+                if (x1 < w && d[y * w + x1] >= r) bounded = false;
+            }
+        }
+        if (bounded) break;
+    }
+
+    int x0 = rect.x0 - r + 1 > 0 ? rect.x0 - r + 1 : 0;
+    int y0 = rect.y0 - r + 1 > 0 ? rect.y0 - r + 1 : 0;
+    int x1 = rect.x1 + r - 1 < w ? rect.x1 + r - 1 : w;
+    int y1 = rect.y1 + r - 1 < h ? rect.y1 + r - 1 : h;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int best = m->tiles[y * w + x] == 1 ? 0 : MAX_DIST_FIELD;
+            if (best > 0) {
+                if (x > 0 && d[y * w + x - 1] + 1 < best) best = d[y * w + x - 1] + 1;
+                if (y > 0) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y - 1) * w + nx] + 1 < best) best = d[(y - 1) * w + nx] + 1;
+                    }
+                }
+                // The right and lower neighbours are only final outside the window
+                if (x == x1 - 1 && x + 1 < w && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+                if (y == y1 - 1 && y + 1 < h) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx;
+                        if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                    }
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+    for (int y = y1 - 1; y >= y0; y--) {
+        for (int x = x1 - 1; x >= x0; x--) {
+            int best = d[y * w + x];
+            if (x < w - 1 && d[y * w + x + 1] + 1 < best) best = d[y * w + x + 1] + 1;
+            if (y < h - 1) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < w && d[(y + 1) * w + nx] + 1 < best) best = d[(y + 1) * w + nx] + 1;
+                }
+            }
+            d[y * w + x] = best;
+        }
+    }
+}
+
+bool viewIsWall(TileView* view, int x, int y) {
+    TileRect* r = &view->rect;
+    if (x < r->x0 || x >= r->x1 || y < r->y0 || y >= r->y1) {
+        return false;
+    }
+    return view->tiles[(y - r->y0) * (r->x1 - r->x0) + (x - r->x0)] == 1;
+}
+
+// Walk the tiles between two points (grid DDA) and report whether a wall is in
+// the way. The tiles holding the two end points are not tested.
+bool lineOfSight(TileView* view, float x0, float y0, float x1, float y1) {
+    int cellX = (int)floorf(x0 / TILE_SIZE);
+    int cellY = (int)floorf(y0 / TILE_SIZE);
+    int endX = (int)floorf(x1 / TILE_SIZE);
+    int endY = (int)floorf(y1 / TILE_SIZE);
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    float tDeltaX = dx != 0 ? fabsf(TILE_SIZE / dx) : INFINITY;
+    float tDeltaY = dy != 0 ? fabsf(TILE_SIZE / dy) : INFINITY;
+    float tMaxX = dx > 0 ? ((cellX + 1) * TILE_SIZE - x0) / dx : dx < 0 ? (cellX * TILE_SIZE - x0) / dx : INFINITY;
+    float tMaxY = dy > 0 ? ((cellY + 1) * TILE_SIZE - y0) / dy : dy < 0 ? (cellY * TILE_SIZE - y0) / dy : INFINITY;
+
+    int steps = abs(endX - cellX) + abs(endY - cellY);
+    for (int i = 0; i < steps - 1; i++) {
+        if (tMaxX < tMaxY) {
+            tMaxX += tDeltaX;
+            cellX += stepX;
+        } else {
+            tMaxY += tDeltaY;
+            cellY += stepY;
+        }
+        if (viewIsWall(view, cellX, cellY)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Light arriving at a point from every light. (nx, ny) is the surface normal,
+// or (0, 0) for the floor, which takes light from every direction.
+int lightAt(Light* lights, int lightCount, TileView* view, float px, float py, float nx, float ny) {
+    float total = AMBIENT_LIGHT;
+    for (int l = 0; l < lightCount; l++) {
+        Light* light = &lights[l];
+        int samples = (light->width > 0 || light->height > 0) ? AREA_LIGHT_SAMPLES : 1;
+        for (int sy = 0; sy < samples; sy++) {
+            for (int sx = 0; sx < samples; sx++) {
+                float lx = light->x;
+                float ly = light->y;
+                if (samples > 1) {
+                    lx += light->width * ((sx + 0.5f) / samples - 0.5f);
+                    ly += light->height * ((sy + 0.5f) / samples - 0.5f);
+                }
+                float dx = lx - px;
+                float dy = ly - py;
+                float dist = sqrtf(dx * dx + dy * dy);
+                if (dist >= light->radius) continue;
+
+                float facing = 1;
+                if (nx != 0 || ny != 0) {
+                    facing = dist > 0 ? (dx * nx + dy * ny) / dist : 1;
+                    if (facing <= 0) continue;
+                }
+                if (!lineOfSight(view, lx, ly, px, py)) continue;
+                total += light->intensity * (1 - dist / light->radius) * facing / (samples * samples);
+            }
+        }
+    }
+    return total > 255 ? 255 : (int)total;
+}
+
+// Bake every wall face and floor texel of the tiles in rect. The output arrays
+// are laid out for rect only, with the same per-tile layout as the lightmaps.
+void bakeLightmaps(Light* lights, int lightCount, TileView* view, TileRect rect, Uint8* wallOut, Uint8* floorOut) {
+    static const int normals[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    int rectWidth = rect.x1 - rect.x0;
+    float nudge = 0.5f;  // Sample just outside the face so its own tile isn't in the way
+
+    for (int ty = rect.y0; ty < rect.y1; ty++) {
+        for (int tx = rect.x0; tx < rect.x1; tx++) {
+            size_t index = (size_t)(ty - rect.y0) * rectWidth + (tx - rect.x0);
+            Uint8* wall = wallOut + index * 4 * LIGHTMAP_FACE_RES;
+            Uint8* floor = floorOut + index * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES;
+
+            if (viewIsWall(view, tx, ty)) {
+                memset(floor, AMBIENT_LIGHT, LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+                for (int face = 0; face < 4; face++) {
+                    int nx = normals[face][0];
+                    int ny = normals[face][1];
+                    if (viewIsWall(view, tx + nx, ty + ny)) {
+                        // Face is buried against another wall and never drawn
+                        memset(wall + face * LIGHTMAP_FACE_RES, AMBIENT_LIGHT, LIGHTMAP_FACE_RES);
+                        continue;
+                    }
+                    for (int t = 0; t < LIGHTMAP_FACE_RES; t++) {
+                        float along = (t + 0.5f) * TILE_SIZE / LIGHTMAP_FACE_RES;
+                        float px, py;
+                        if (nx != 0) {
+                            px = tx * TILE_SIZE + (nx > 0 ? TILE_SIZE + nudge : -nudge);
+                            py = ty * TILE_SIZE + along;
+                        } else {
+                            px = tx * TILE_SIZE + along;
+                            py = ty * TILE_SIZE + (ny > 0 ? TILE_SIZE + nudge : -nudge);
+                        }
+                        wall[face * LIGHTMAP_FACE_RES + t] = lightAt(lights, lightCount, view, px, py, nx, ny);
+                    }
+                }
+            } else {
+                memset(wall, AMBIENT_LIGHT, 4 * LIGHTMAP_FACE_RES);
+                for (int fy = 0; fy < LIGHTMAP_FLOOR_RES; fy++) {
+                    for (int fx = 0; fx < LIGHTMAP_FLOOR_RES; fx++) {
+                        float px = tx * TILE_SIZE + (fx + 0.5f) * TILE_SIZE / LIGHTMAP_FLOOR_RES;
+                        float py = ty * TILE_SIZE + (fy + 0.5f) * TILE_SIZE / LIGHTMAP_FLOOR_RES;
+                        floor[fy * LIGHTMAP_FLOOR_RES + fx] = lightAt(lights, lightCount, view, px, py, 0, 0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool allocLightmaps(Lightmaps* lm, int width, int height) {
+    size_t tiles = (size_t)width * height;
+    lm->wall = malloc(tiles * 4 * LIGHTMAP_FACE_RES);
+    lm->floor = malloc(tiles * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+    return lm->wall != NULL && lm->floor != NULL;
+}
+
+void freeLightmaps(Lightmaps* lm) {
+    free(lm->wall);
+    free(lm->floor);
+    lm->wall = lm->floor = NULL;
+}
+
+// Full bake of the live map, used once at startup
+void bakeAllLightmaps(void) {
+    TileRect all = { 0, 0, map.width, map.height };
+    TileView view = { all, map.tiles };
+    bakeLightmaps(map.lights, map.lightCount, &view, all, lightmaps.wall, lightmaps.floor);
+}
+
+// Reach of the strongest light in tiles, used to size job snapshots
+int maxLightReach(void) {
+    float reach = 0;
+    for (int l = 0; l < map.lightCount; l++) {
+        float r = map.lights[l].radius + fmaxf(map.lights[l].width, map.lights[l].height) / 2;
+        if (r > reach) reach = r;
+    }
+    return (int)ceilf(reach / TILE_SIZE) + 1;
+}
+
+TileRect clipRect(TileRect r) {
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > map.width) r.x1 = map.width;
+    if (r.y1 > map.height) r.y1 = map.height;
+    return r;
+}
+
+void runLightJob(LightJob* job) {
+    bakeLightmaps(job->lights, job->lightCount, &job->view, job->rect, job->wall, job->floor);
+
+    // Publish the results; the renderer holds the lock while it samples
+    SDL_LockMutex(baker.lock);
+    int rectWidth = job->rect.x1 - job->rect.x0;
+    size_t wallRow = (size_t)rectWidth * 4 * LIGHTMAP_FACE_RES;
+    size_t floorRow = (size_t)rectWidth * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES;
+    for (int y = job->rect.y0; y < job->rect.y1; y++) {
+        size_t live = (size_t)y * map.width + job->rect.x0;
+        memcpy(lightmaps.wall + live * 4 * LIGHTMAP_FACE_RES, job->wall + (y - job->rect.y0) * wallRow, wallRow);
+        memcpy(lightmaps.floor + live * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES, job->floor + (y - job->rect.y0) * floorRow, floorRow);
+    }
+    SDL_UnlockMutex(baker.lock);
+}
+
+void freeLightJob(LightJob* job) {
+    free((void*)job->view.tiles);
+    free(job->wall);
+    free(job->floor);
+    free(job);
+}
+
+int lightBakeThread(void* data) {
+    SDL_LockMutex(baker.lock);
+    while (true) {
+        while (baker.count == 0 && !baker.quit) {
+            SDL_CondWait(baker.changed, baker.lock);
+        }
+        if (baker.quit) {
+            break;
+        }
+        LightJob* job = baker.jobs[baker.head];
+        baker.head = (baker.head + 1) % MAX_LIGHT_JOBS;
+        baker.count--;
+        SDL_CondSignal(baker.changed);
+        SDL_UnlockMutex(baker.lock);
+
+        runLightJob(job);
+        freeLightJob(job);
+        SDL_LockMutex(baker.lock);
+    }
+    SDL_UnlockMutex(baker.lock);
+    return 0;
+}
+
+void startLightBaker(bool synchronous) {
+    baker.lock = SDL_CreateMutex();
+    baker.changed = SDL_CreateCond();
+    baker.head = baker.count = 0;
+    baker.quit = false;
+    baker.synchronous = synchronous;
+    baker.thread = synchronous ? NULL : SDL_CreateThread(lightBakeThread, "light baker", NULL);
+}
+
+void stopLightBaker(void) {
+    if (baker.thread != NULL) {
+        SDL_LockMutex(baker.lock);
+        baker.quit = true;
+        SDL_CondSignal(baker.changed);
+        SDL_UnlockMutex(baker.lock);
+        SDL_WaitThread(baker.thread, NULL);
+        while (baker.count > 0) {
+            freeLightJob(baker.jobs[baker.head]);
+            baker.head = (baker.head + 1) % MAX_LIGHT_JOBS;
+            baker.count--;
+        }
+    }
+    SDL_DestroyCond(baker.changed);
+    SDL_DestroyMutex(baker.lock);
+}
+
+// Queue a rebake of the tiles in rect
+void queueRelight(TileRect rect) {
+    rect = clipRect(rect);
+    if (baker.lock == NULL || rect.x0 >= rect.x1 || rect.y0 >= rect.y1) {
+        return;
+    }
+
+    // Snapshot every tile that a shadow ray for this area can cross
+    int reach = maxLightReach();
+    TileRect snap = clipRect((TileRect){ rect.x0 - reach, rect.y0 - reach, rect.x1 + reach, rect.y1 + reach });
+    int snapWidth = snap.x1 - snap.x0;
+    Uint8* tiles = malloc((size_t)snapWidth * (snap.y1 - snap.y0));
+    for (int ty = snap.y0; ty < snap.y1; ty++) {
+        memcpy(tiles + (size_t)(ty - snap.y0) * snapWidth, map.tiles + (size_t)ty * map.width + snap.x0, snapWidth);
+    }
+
+    size_t rectTiles = (size_t)(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+    LightJob* job = malloc(sizeof(LightJob));
+    job->rect = rect;
+    job->view.rect = snap;
+    job->view.tiles = tiles;
+    job->wall = malloc(rectTiles * 4 * LIGHTMAP_FACE_RES);
+    job->floor = malloc(rectTiles * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES);
+    memcpy(job->lights, map.lights, sizeof(job->lights));
+    job->lightCount = map.lightCount;
+
+    if (baker.synchronous) {
+        runLightJob(job);
+        freeLightJob(job);
+        return;
+    }
+    SDL_LockMutex(baker.lock);
+    while (baker.count == MAX_LIGHT_JOBS) {
+        SDL_CondWait(baker.changed, baker.lock);
+    }
+    baker.jobs[(baker.head + baker.count) % MAX_LIGHT_JOBS] = job;
+    baker.count++;
+    SDL_CondSignal(baker.changed);
+    SDL_UnlockMutex(baker.lock);
+}
+
+// Tiles within reach of a light
+TileRect lightRect(Light* light) {
+    float reach = light->radius + fmaxf(light->width, light->height) / 2;
+    int x0 = (int)floorf((light->x - reach) / TILE_SIZE);
+    int y0 = (int)floorf((light->y - reach) / TILE_SIZE);
+    int x1 = (int)floorf((light->x + reach) / TILE_SIZE) + 1;
+    int y1 = (int)floorf((light->y + reach) / TILE_SIZE) + 1;
+    return (TileRect){ x0, y0, x1, y1 };
+}
+
+// Queue a rebake of everything a change to the tiles in changed can affect: the
+// tiles and their neighbours, plus the whole area of every light that reaches them
+void relightRect(TileRect changed) {
+    if (map.lightCount == 0) {
+        return;
+    }
+
+    TileRect rect = { changed.x0 - 1, changed.y0 - 1, changed.x1 + 1, changed.y1 + 1 };
+    for (int l = 0; l < map.lightCount; l++) {
+        Light* light = &map.lights[l];
+        float reach = light->radius + fmaxf(light->width, light->height) / 2;
+        float nearX = fmaxf(changed.x0 * TILE_SIZE, fminf(light->x, changed.x1 * TILE_SIZE));
+        float nearY = fmaxf(changed.y0 * TILE_SIZE, fminf(light->y, changed.y1 * TILE_SIZE));
+        if (hypotf(light->x - nearX, light->y - nearY) >= reach) continue;
+
+        TileRect lit = lightRect(light);
+        if (lit.x0 < rect.x0) rect.x0 = lit.x0;
+        if (lit.y0 < rect.y0) rect.y0 = lit.y0;
+        if (lit.x1 > rect.x1) rect.x1 = lit.x1;
+        if (lit.y1 > rect.y1) rect.y1 = lit.y1;
+    }
+    queueRelight(rect);
+}
+
+void relightTile(int x, int y) {
+    relightRect((TileRect){ x, y, x + 1, y + 1 });
+}
+
+void setTile(int x, int y, int value) {
+    size_t index = (size_t)y * map.width + x;
+    map.hash ^= tileHash(index, map.tiles[index]) ^ tileHash(index, value);
+    map.tiles[index] = value;
+    if (value == 1 && map.floors[index] + map.heights[index] > map.maxTop) {
+        map.maxTop = map.floors[index] + map.heights[index];
+    }
+    updateDistanceField(&map, (TileRect){ x, y, x + 1, y + 1 });
+    relightTile(x, y);
+}
+
+int blockTop(Map* m, size_t index) {
+    return m->floors[index] + (m->tiles[index] == 1 ? m->heights[index] : 0);
+}
+
+void updateMaxTop(Map* m) {
+    size_t count = (size_t)m->width * m->height;
+    m->maxTop = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (blockTop(m, i) > m->maxTop) m->maxTop = blockTop(m, i);
+    }
+}
+
+void freeMap(Map* m) {
+    free(m->tiles);
+    free(m->distField);
+    free(m->heights);
+    free(m->floors);
+    m->tiles = m->distField = m->heights = m->floors = NULL;
+}
+
+bool allocMap(Map* m, int width, int height) {
+    m->width = width;
+    m->height = height;
+    m->lightCount = 0;
+    m->tiles = malloc((size_t)width * height);
+    m->distField = malloc((size_t)width * height);
+    m->heights = malloc((size_t)width * height);
+    m->floors = malloc((size_t)width * height);
+    if (m->tiles == NULL || m->distField == NULL || m->heights == NULL || m->floors == NULL) {
+        freeMap(m);
+        return false;
+    }
+    // Maps without height layers get standard walls on flat ground
+    memset(m->heights, DEFAULT_WALL_HEIGHT, (size_t)width * height);
+    memset(m->floors, 0, (size_t)width * height);
+    return true;
+}
+
+void loadDefaultMap(Map* m) {
+    allocMap(m, MAP_WIDTH, MAP_HEIGHT);
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            m->tiles[y * MAP_WIDTH + x] = defaultMap[y][x];
+        }
+    }
+    // A low wall in front of a tall one, and a raised platform
+    m->heights[4 * MAP_WIDTH + 3] = 3;
+    m->heights[5 * MAP_WIDTH + 3] = 3;
+    m->heights[2 * MAP_WIDTH + 6] = 14;
+    m->heights[3 * MAP_WIDTH + 5] = 5;
+    m->floors[5 * MAP_WIDTH + 7] = 2;
+    m->floors[5 * MAP_WIDTH + 8] = 2;
+    m->floors[6 * MAP_WIDTH + 7] = 2;
+    m->floors[6 * MAP_WIDTH + 8] = 2;
+    updateMaxTop(m);
+    m->lightCount = sizeof(defaultLights) / sizeof(defaultLights[0]);
+    memcpy(m->lights, defaultLights, sizeof(defaultLights));
+    buildDistanceField(m);
+    m->hash = hashTiles(m);
+}
+
+Uint32 crcTable[256];
+
+Uint32 crc32(const Uint8* data, size_t size) {
+    if (crcTable[1] == 0) {
+        for (Uint32 i = 0; i < 256; i++) {
+            Uint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crcTable[i] = c;
+        }
+    }
+    Uint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+Uint32 readU32(const Uint8* p) {
+    return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+Uint16 readU16(const Uint8* p) {
+    return (Uint16)(p[0] | (p[1] << 8));
+}
+
+void writeU32(Uint8* p, Uint32 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+void writeU16(Uint8* p, Uint16 v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+Uint32 readF32Bits(const Uint8* p, float* value) {
+    Uint32 bits = readU32(p);
+    memcpy(value, &bits, 4);
+    return bits;
+}
+
+void writeF32(Uint8* p, float value) {
+    Uint32 bits;
+    memcpy(&bits, &value, 4);
+    writeU32(p, bits);
+}
+
+// Run-length encoding in PackBits style: a control byte c < 128 is followed by
+// c + 1 literal bytes, a control byte c >= 128 repeats the next byte c - 126 times.
+// Literals cost a control byte per 128, so alternating data grows by up to a
+// third; encoding stops and returns capacity once the output would not fit.
+size_t rleEncode(const Uint8* src, size_t size, Uint8* dst, size_t capacity) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        size_t run = 1;
+        while (in + run < size && run < 129 && src[in + run] == src[in]) run++;
+        if (run >= 2) {
+            if (out + 2 > capacity) return capacity;
+            dst[out++] = (Uint8)(run + 126);
+            dst[out++] = src[in];
+            in += run;
+        } else {
+            size_t start = in;
+            size_t count = 0;
+            while (in < size && count < 128 && !(in + 1 < size && src[in + 1] == src[in])) {
+                in++;
+                count++;
+            }
+            if (out + 1 + count > capacity) return capacity;
+            dst[out++] = (Uint8)(count - 1);
+            memcpy(dst + out, src + start, count);
+            out += count;
+        }
+    }
+    return out;
+}
+
+// Decode straight into the destination layer; fails on any overrun or short data
+bool rleDecode(const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < size) {
+        Uint8 c = src[in++];
+        if (c < 128) {
+            size_t count = c + 1;
+            if (in + count > size || out + count > dstSize) return false;
+            memcpy(dst + out, src + in, count);
+            in += count;
+            out += count;
+        } else {
+            size_t count = c - 126;
+            if (in >= size || out + count > dstSize) return false;
+            memset(dst + out, src[in++], count);
+            out += count;
+        }
+    }
+    return out == dstSize;
+}
+
+bool decodeLayer(int encoding, const Uint8* src, size_t size, Uint8* dst, size_t dstSize) {
+    if (encoding == ENCODING_RAW) {
+        if (size != dstSize) return false;
+        memcpy(dst, src, size);
+        return true;
+    }
+    if (encoding == ENCODING_RLE) {
+        return rleDecode(src, size, dst, dstSize);
+    }
+    return false;
+}
+
+// Load a map file. The whole file is read with a single fread, checked, and then
+// every layer is decoded directly into the freshly allocated map.
+bool loadMapFile(const char* path, Map* out) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open map file %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (fileSize < MAP_HEADER_SIZE) {
+        printf("Map file %s is too small\n", path);
+        fclose(file);
+        return false;
+    }
+
+    Uint8* data = malloc(fileSize);
+    if (data == NULL || fread(data, 1, fileSize, file) != (size_t)fileSize) {
+        printf("Could not read map file %s\n", path);
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    Uint16 version = readU16(data + 4);
+    int layerCount = readU16(data + 6);
+    Uint32 width = readU32(data + 8);
+    Uint32 height = readU32(data + 12);
+    Uint32 checksum = readU32(data + 16);
+    if (memcmp(data, MAP_MAGIC, 4) != 0 || version != MAP_VERSION) {
+        printf("%s is not a version %d map file\n", path, MAP_VERSION);
+        free(data);
+        return false;
+    }
+    if (width == 0 || height == 0 || width > MAX_MAP_SIDE || height > MAX_MAP_SIDE) {
+        printf("Map file %s has bad dimensions %ux%u\n", path, width, height);
+        free(data);
+        return false;
+    }
+    if (crc32(data + MAP_HEADER_SIZE, fileSize - MAP_HEADER_SIZE) != checksum) {
+        printf("Map file %s failed its checksum\n", path);
+        free(data);
+        return false;
+    }
+
+    Map m;
+    if (!allocMap(&m, width, height)) {
+        printf("Not enough memory for a %ux%u map\n", width, height);
+        free(data);
+        return false;
+    }
+
+    size_t layerSize = (size_t)width * height;
+    size_t pos = MAP_HEADER_SIZE;
+    bool haveTiles = false;
+    bool haveDistField = false;
+    for (int i = 0; i < layerCount; i++) {
+        if (pos + LAYER_HEADER_SIZE > (size_t)fileSize) break;
+        int type = data[pos];
+        int encoding = data[pos + 1];
+        size_t size = readU32(data + pos + 4);
+        pos += LAYER_HEADER_SIZE;
+        if (size > (size_t)fileSize - pos) break;
+
+        Uint8* dst = NULL;
+        if (type == LAYER_TILES) dst = m.tiles;
+        if (type == LAYER_DIST_FIELD) dst = m.distField;
+        if (type == LAYER_HEIGHTS) dst = m.heights;
+        if (type == LAYER_FLOORS) dst = m.floors;
+        if (dst != NULL) {
+            if (!decodeLayer(encoding, data + pos, size, dst, layerSize)) {
+                printf("Map file %s has a corrupt layer %d\n", path, type);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            if (type == LAYER_TILES) haveTiles = true;
+            if (type == LAYER_DIST_FIELD) haveDistField = true;
+        }
+        if (type == LAYER_LIGHTS) {
+            Uint32 count = size >= 4 ? readU32(data + pos) : 0;
+            if (encoding != ENCODING_RAW || count > MAX_LIGHTS || size != 4 + count * LIGHT_RECORD_SIZE) {
+                printf("Map file %s has a corrupt light layer\n", path);
+                freeMap(&m);
+                free(data);
+                return false;
+            }
+            for (Uint32 l = 0; l < count; l++) {
+                const Uint8* p = data + pos + 4 + l * LIGHT_RECORD_SIZE;
+                readF32Bits(p, &m.lights[l].x);
+                readF32Bits(p + 4, &m.lights[l].y);
+                readF32Bits(p + 8, &m.lights[l].width);
+                readF32Bits(p + 12, &m.lights[l].height);
+                readF32Bits(p + 16, &m.lights[l].radius);
+                readF32Bits(p + 20, &m.lights[l].intensity);
+            }
+            m.lightCount = count;
+        }
+        pos += size;
+    }
+    free(data);
+
+    if (!haveTiles) {
+        printf("Map file %s has no tile layer\n", path);
+        freeMap(&m);
+        return false;
+    }
+    if (!haveDistField) {
+        buildDistanceField(&m);
+    }
+    updateMaxTop(&m);
+    m.hash = hashTiles(&m);
+    *out = m;
+    return true;
+}
+
+// Append one RLE layer at pos, falling back to raw storage if RLE doesn't help
+size_t writeLayer(Uint8* dst, int type, const Uint8* src, size_t size) {
+    size_t encoded = rleEncode(src, size, dst + LAYER_HEADER_SIZE, size);
+    int encoding = ENCODING_RLE;
+    if (encoded >= size) {
+        memcpy(dst + LAYER_HEADER_SIZE, src, size);
+        encoded = size;
+        encoding = ENCODING_RAW;
+    }
+    dst[0] = type;
+    dst[1] = encoding;
+    writeU16(dst + 2, 0);
+    writeU32(dst + 4, encoded);
+    return LAYER_HEADER_SIZE + encoded;
+}
+
+bool saveMapFile(const char* path, Map* m) {
+    size_t layerSize = (size_t)m->width * m->height;
+    // writeLayer never stores more than the raw layer
+    size_t maxLayer = LAYER_HEADER_SIZE + layerSize;
+    Uint8* data = malloc(MAP_HEADER_SIZE + 4 * maxLayer + LAYER_HEADER_SIZE + 4 + MAX_LIGHTS * LIGHT_RECORD_SIZE);
+    if (data == NULL) {
+        printf("Not enough memory to save %s\n", path);
+        return false;
+    }
+
+    size_t pos = MAP_HEADER_SIZE;
+    pos += writeLayer(data + pos, LAYER_TILES, m->tiles, layerSize);
+    pos += writeLayer(data + pos, LAYER_DIST_FIELD, m->distField, layerSize);
+    pos += writeLayer(data + pos, LAYER_HEIGHTS, m->heights, layerSize);
+    pos += writeLayer(data + pos, LAYER_FLOORS, m->floors, layerSize);
+
+    Uint8* lightLayer = data + pos;
+    lightLayer[0] = LAYER_LIGHTS;
+    lightLayer[1] = ENCODING_RAW;
+    writeU16(lightLayer + 2, 0);
+    writeU32(lightLayer + 4, 4 + m->lightCount * LIGHT_RECORD_SIZE);
+    writeU32(lightLayer + 8, m->lightCount);
+    for (int l = 0; l < m->lightCount; l++) {
+        Uint8* p = lightLayer + 12 + l * LIGHT_RECORD_SIZE;
+        writeF32(p, m->lights[l].x);
+        writeF32(p + 4, m->lights[l].y);
+        writeF32(p + 8, m->lights[l].width);
+        writeF32(p + 12, m->lights[l].height);
+        writeF32(p + 16, m->lights[l].radius);
+        writeF32(p + 20, m->lights[l].intensity);
+    }
+    pos += LAYER_HEADER_SIZE + 4 + m->lightCount * LIGHT_RECORD_SIZE;
+
+    memcpy(data, MAP_MAGIC, 4);
+    writeU16(data + 4, MAP_VERSION);
+    writeU16(data + 6, 5);
+    writeU32(data + 8, m->width);
+    writeU32(data + 12, m->height);
+    writeU32(data + 16, crc32(data + MAP_HEADER_SIZE, pos - MAP_HEADER_SIZE));
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file != NULL && fwrite(data, 1, pos, file) == pos;
+    if (file != NULL && fclose(file) != 0) ok = false;
+    free(data);
+    if (!ok) {
+        printf("Could not write map file %s\n", path);
+    }
+    return ok;
+}
+
+// Diff a reloaded copy of the map into the live one, touching only what
+// changed. Chunks whose rows compare equal are skipped with one memcmp per row;
+// each chunk with changed tiles gets its distance field and lightmaps patched,
+// so a small change to a big map costs about as much as an editor click.
+bool applyMapReload(Map* m) {
+    int w = map.width;
+    int h = map.height;
+    if (m->width != w || m->height != h) {
+        printf("Reloaded map is %dx%d instead of %dx%d, restart to load it\n", m->width, m->height, w, h);
+        return false;
+    }
+
+    // Lights go in first so the tile rebakes below already use them
+    Light oldLights[MAX_LIGHTS];
+    int oldCount = map.lightCount;
+    memcpy(oldLights, map.lights, sizeof(oldLights));
+    bool lightsChanged = m->lightCount != map.lightCount || memcmp(m->lights, map.lights, m->lightCount * sizeof(Light)) != 0;
+    if (lightsChanged) {
+        memcpy(map.lights, m->lights, sizeof(map.lights));
+        map.lightCount = m->lightCount;
+    }
+
+    int changedTiles = 0;
+    int changedChunks = 0;
+    for (int cy = 0; cy < h; cy += RELOAD_CHUNK) {
+        int cy1 = cy + RELOAD_CHUNK < h ? cy + RELOAD_CHUNK : h;
+        bool rowsChanged = false;
+        for (int y = cy; y < cy1 && !rowsChanged; y++) {
+            size_t row = (size_t)y * w;
+            rowsChanged = memcmp(map.tiles + row, m->tiles + row, w) != 0 ||
+                memcmp(map.heights + row, m->heights + row, w) != 0 ||
+                memcmp(map.floors + row, m->floors + row, w) != 0;
+        }
+        if (!rowsChanged) continue;
+
+        for (int cx = 0; cx < w; cx += RELOAD_CHUNK) {
+            int cx1 = cx + RELOAD_CHUNK < w ? cx + RELOAD_CHUNK : w;
+            TileRect dirty = { cx1, cy1, cx, cy };  // Empty until a tile changes
+            bool blocksChanged = false;
+            for (int y = cy; y < cy1; y++) {
+                for (int x = cx; x < cx1; x++) {
+                    size_t index = (size_t)y * w + x;
+                    if (map.heights[index] != m->heights[index] || map.floors[index] != m->floors[index]) {
+                        map.heights[index] = m->heights[index];
+                        map.floors[index] = m->floors[index];
+                        blocksChanged = true;
+                    }
+                    if (map.tiles[index] != m->tiles[index]) {
+                        map.hash ^= tileHash(index, map.tiles[index]) ^ tileHash(index, m->tiles[index]);
+                        map.tiles[index] = m->tiles[index];
+                        blocksChanged = true;
+                        changedTiles++;
+                        if (x < dirty.x0) dirty.x0 = x;
+                        if (y < dirty.y0) dirty.y0 = y;
+                        if (x >= dirty.x1) dirty.x1 = x + 1;
+                        if (y >= dirty.y1) dirty.y1 = y + 1;
+                    }
+                    if (blockTop(&map, index) > map.maxTop) map.maxTop = blockTop(&map, index);
+                }
+            }
+            if (blocksChanged) changedChunks++;
+            if (dirty.x0 < dirty.x1) {
+                updateDistanceField(&map, dirty);
+                relightRect(dirty);
+            }
+        }
+    }
+
+    if (lightsChanged) {
+        if (oldCount == 0) {
+            // Lightmaps aren't kept up to date while the map has no lights
+            queueRelight((TileRect){ 0, 0, w, h });
+        } else {
+            for (int l = 0; l < oldCount; l++) queueRelight(lightRect(&oldLights[l]));
+            for (int l = 0; l < map.lightCount; l++) queueRelight(lightRect(&map.lights[l]));
+        }
+    }
+    if (changedChunks > 0 || lightsChanged) {
+        printf("Reloaded map: %d tiles changed in %d chunks%s\n", changedTiles, changedChunks, lightsChanged ? ", lights changed" : "");
+    }
+    return true;
+}
+
+void stopMapWatch(MapWatch* watch) {
+#ifdef __linux__
+    if (watch->fd >= 0) {
+        close(watch->fd);
+    }
+#endif
+    watch->fd = -1;
+}
+
+// Watch the directory rather than the file: many editors save by writing a new
+// file and renaming it over the old one, which would end a watch on the file
+bool startMapWatch(MapWatch* watch, const char* path) {
+    watch->fd = -1;
+#ifdef __linux__
+    const char* slash = strrchr(path, '/');
+    const char* name = slash != NULL ? slash + 1 : path;
+    char dir[4096] = ".";
+    if (slash != NULL) {
+        size_t length = slash == path ? 1 : (size_t)(slash - path);
+        if (length >= sizeof(dir)) {
+            printf("Map path %s is too long to watch\n", path);
+            return false;
+        }
+        memcpy(dir, path, length);
+        dir[length] = 0;
+    }
+    if (strlen(name) >= sizeof(watch->name)) {
+        printf("Map path %s is too long to watch\n", path);
+        return false;
+    }
+    strcpy(watch->name, name);
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0 || inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        printf("Could not watch %s for changes\n", path);
+        stopMapWatch(watch);
+        return false;
+    }
+    return true;
+#else
+    printf("Watching map files needs inotify, which this platform doesn't have\n");
+    return false;
+#endif
+}
+
+// True if the map file was written or replaced since the last call. Never blocks.
+bool mapFileChanged(MapWatch* watch) {
+    bool changed = false;
+#ifdef __linux__
+    if (watch->fd < 0) {
+        return false;
+    }
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+    while ((size = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + size; ) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+    return changed;
+}
+
+// Function to check for wall collision
+bool isWallIn(Map* m, int x, int y) {
+    int mapX = x / TILE_SIZE;
+    int mapY = y / TILE_SIZE;
+    if (mapX >= 0 && mapX < m->width && mapY >= 0 && mapY < m->height) {
+        return m->tiles[(size_t)mapY * m->width + mapX] == 1;
+    }
+    return false;
+}
+
+bool isWall(int x, int y) {
+    return isWallIn(&map, x, y);
+}
+
+// In the terrain view only the edges of the map are in the way
+bool canMoveOnTerrain(Player* player, float deltaX, float deltaY) {
+    float newX = player->x + deltaX;
+    float newY = player->y + deltaY;
+    return newX >= 0 && newY >= 0 && newX < simMap->width * TILE_SIZE && newY < simMap->height * TILE_SIZE;
+}
+
+// Check if the player can move to the new position
+bool canMoveTo(Player* player, float deltaX, float deltaY) {
+    float newX = player->x + deltaX;
+    float newY = player->y + deltaY;
+    return !isWallIn(simMap, newX, newY);
+}
+
+bool pushEdit(EditQueue* q, QueuedEdit edit) {
+    Uint32 tail = SDL_AtomicGet(&q->tail);
+    if (tail - (Uint32)SDL_AtomicGet(&q->head) == EDIT_QUEUE_SIZE) {
+        return false;
+    }
+    q->edits[tail & (EDIT_QUEUE_SIZE - 1)] = edit;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&q->tail, tail + 1);
+    return true;
+}
+
+// Pass on the main thread's events until the queue is full; the rest stay in
+// SDL's own queue until the next call
+void forwardEvents(EventQueue* q) {
+    Uint32 tail = SDL_AtomicGet(&q->tail);
+    while (tail - (Uint32)SDL_AtomicGet(&q->head) < EVENT_QUEUE_SIZE &&
+        SDL_PollEvent(&q->events[tail & (EVENT_QUEUE_SIZE - 1)])) {
+        tail++;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&q->tail, tail);
+    }
+}
+
+// The game loop's SDL_PollEvent: under --threaded it takes the events the main
+// thread passed on, and keeps the key and mouse state up to date from them
+bool nextEvent(SDL_Event* e) {
+    EventQueue* q = &eventQueue;
+    if (!q->active) {
+        return SDL_PollEvent(e) != 0;
+    }
+    Uint32 head = SDL_AtomicGet(&q->head);
+    if (head == (Uint32)SDL_AtomicGet(&q->tail)) {
+        return false;
+    }
+    SDL_MemoryBarrierAcquire();
+    *e = q->events[head & (EVENT_QUEUE_SIZE - 1)];
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&q->head, head + 1);
+    if (e->type == SDL_KEYDOWN || e->type == SDL_KEYUP) {
+        q->keys[e->key.keysym.scancode] = e->type == SDL_KEYDOWN;
+        q->mods = e->key.keysym.mod;
+    }
+    if (e->type == SDL_MOUSEMOTION) {
+        q->mouseX = e->motion.x;
+        q->mouseY = e->motion.y;
+    }
+    if (e->type == SDL_MOUSEBUTTONDOWN || e->type == SDL_MOUSEBUTTONUP) {
+        q->mouseX = e->button.x;
+        q->mouseY = e->button.y;
+    }
+    return true;
+}
+
+const Uint8* keyboardState(void) {
+    return eventQueue.active ? eventQueue.keys : SDL_GetKeyboardState(NULL);
+}
+
+SDL_Keymod modState(void) {
+    return eventQueue.active ? eventQueue.mods : SDL_GetModState();
+}
+
+void mouseState(int* x, int* y) {
+    if (eventQueue.active) {
+        *x = eventQueue.mouseX;
+        *y = eventQueue.mouseY;
+    } else {
+        SDL_GetMouseState(x, y);
+    }
+}
+
+// Apply queued edits to the real map up to and including version, so the map
+// always matches the snapshot being drawn even if the simulation is ahead
+void applyQueuedEdits(EditQueue* q, Uint32 version) {
+    Uint32 head = SDL_AtomicGet(&q->head);
+    Uint32 tail = SDL_AtomicGet(&q->tail);
+    SDL_MemoryBarrierAcquire();
+    while (head != tail) {
+        QueuedEdit* edit = &q->edits[head & (EDIT_QUEUE_SIZE - 1)];
+        if ((Sint32)(edit->version - version) > 0) break;
+        if (edit->reload != NULL) {
+            applyMapReload(edit->reload);
+            freeMap(edit->reload);
+            free(edit->reload);
+        } else {
+            setTile(edit->x, edit->y, edit->value);
+        }
+        head++;
+    }
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&q->head, head);
+}
+
+// Send a change on to the real map, or keep it in editBacklog when the queue
+// is full or earlier changes are still waiting there
+void sendEdit(QueuedEdit edit) {
+    EditBacklog* b = &editBacklog;
+    bool waiting = b->reload != NULL || b->rect.x0 < b->rect.x1;
+    if (!waiting && pushEdit(&editQueue, edit)) {
+        return;
+    }
+    if (edit.reload != NULL) {
+        // A newer reload makes an older one that is still waiting pointless
+        if (b->reload != NULL) {
+            freeMap(b->reload);
+            free(b->reload);
+        }
+        b->reload = edit.reload;
+        return;
+    }
+    if (!waiting) {
+        printf("Edit queue full, holding map changes back until the 3D view catches up\n");
+    }
+    TileRect* r = &b->rect;
+    if (r->x0 >= r->x1) {
+        *r = (TileRect){ edit.x, edit.y, edit.x + 1, edit.y + 1 };
+    } else {
+        if (edit.x < r->x0) r->x0 = edit.x;
+        if (edit.y < r->y0) r->y0 = edit.y;
+        if (edit.x + 1 > r->x1) r->x1 = edit.x + 1;
+        if (edit.y + 1 > r->y1) r->y1 = edit.y + 1;
+    }
+    b->x = b->rect.x0;
+    b->y = b->rect.y0;
+}
+
+// Send what waits in editBacklog as far as the queue has room, once a tick.
+// The tiles are read from simMap, which has the latest of every one, so the
+// real map ends up matching it even though the single changes are gone.
+void flushEditBacklog(void) {
+    EditBacklog* b = &editBacklog;
+    if (b->reload != NULL) {
+        QueuedEdit edit = { 0, 0, 0, mapVersion, b->reload };
+        if (!pushEdit(&editQueue, edit)) return;
+        b->reload = NULL;
+    }
+    for (; b->y < b->rect.y1; b->y++, b->x = b->rect.x0) {
+        for (; b->x < b->rect.x1; b->x++) {
+            QueuedEdit edit = { b->x, b->y, simMap->tiles[(size_t)b->y * simMap->width + b->x], mapVersion, NULL };
+            if (!pushEdit(&editQueue, edit)) return;
+        }
+    }
+    b->rect = (TileRect){ 0, 0, 0, 0 };
+}
+
+// Toggle between wall (1) and empty (0) in the simulation's map
+void simToggleTile(int x, int y) {
+    size_t index = (size_t)y * simMap->width + x;
+    int value = simMap->tiles[index] == 1 ? 0 : 1;
+    if (simMap == &map) {
+        setTile(x, y, value);
+        return;
+    }
+    simMap->hash ^= tileHash(index, simMap->tiles[index]) ^ tileHash(index, value);
+    simMap->tiles[index] = value;
+    mapVersion++;
+    QueuedEdit edit = { x, y, value, mapVersion, NULL };
+    sendEdit(edit);
+}
+
+// Tiles-only copy of the map for the simulation to collide with
+bool startCollisionMap(void) {
+    size_t count = (size_t)map.width * map.height;
+    collisionMap.width = map.width;
+    collisionMap.height = map.height;
+    collisionMap.tiles = malloc(count);
+    if (collisionMap.tiles == NULL) return false;
+    memcpy(collisionMap.tiles, map.tiles, count);
+    collisionMap.hash = map.hash;
+    simMap = &collisionMap;
+    return true;
+}
+
+// Load the changed map file and send it to whichever thread owns the live map.
+// A half-written file fails its CRC check; the write that finishes it brings
+// another change event.
+void reloadMap(const char* path) {
+    Map* reloaded = calloc(1, sizeof(Map));
+    if (reloaded == NULL || !loadMapFile(path, reloaded)) {
+        free(reloaded);
+        return;
+    }
+    if (simMap == &map) {
+        applyMapReload(reloaded);
+    } else if (reloaded->width == simMap->width && reloaded->height == simMap->height) {
+        size_t count = (size_t)simMap->width * simMap->height;
+        for (size_t i = 0; i < count; i++) {
+            if (simMap->tiles[i] != reloaded->tiles[i]) {
+                simMap->hash ^= tileHash(i, simMap->tiles[i]) ^ tileHash(i, reloaded->tiles[i]);
+                simMap->tiles[i] = reloaded->tiles[i];
+            }
+        }
+        mapVersion++;
+        QueuedEdit edit = { 0, 0, 0, mapVersion, reloaded };
+        sendEdit(edit);
+        return;
+    } else {
+        printf("Reloaded map is %dx%d instead of %dx%d, restart to load it\n",
+            reloaded->width, reloaded->height, simMap->width, simMap->height);
+    }
+    freeMap(reloaded);
+    free(reloaded);
+}
+
+// Advance the game by one tick. This is the only place input changes the world,
+// so feeding it the same TickInputs always produces the same game.
+void simulateTick(Player* player, TickInput* input) {
+    for (int i = 0; i < input->editCount; i++) {
+        int gridX = input->edits[i].x;
+        int gridY = input->edits[i].y;
+        if (gridX < simMap->width && gridY < simMap->height) {
+            simToggleTile(gridX, gridY);
+        }
+    }
+
+    // Handle player movement
+    float speed = 2.0f;
+    bool (*canMove)(Player*, float, float) = input->buttons & INPUT_TERRAIN ? canMoveOnTerrain : canMoveTo;
+    if (input->buttons & INPUT_FORWARD) {
+        float deltaX = cos(player->angle * M_PI / 180) * speed;
+        float deltaY = sin(player->angle * M_PI / 180) * speed;
+        if (canMove(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_BACK) {
+        float deltaX = -cos(player->angle * M_PI / 180) * speed;
+        float deltaY = -sin(player->angle * M_PI / 180) * speed;
+        if (canMove(player, deltaX, deltaY)) {
+            player->x += deltaX;
+            player->y += deltaY;
+        }
+    }
+    if (input->buttons & INPUT_LEFT) {
+        player->angle -= 2.0f; // Rotate left
+    }
+    if (input->buttons & INPUT_RIGHT) {
+        player->angle += 2.0f; // Rotate right
+    }
+}
+
+// Hash of everything the simulation owns, compared between runs to prove that
+// a change didn't alter behaviour
+Uint64 stateHash(Player* player) {
+    Uint32 bits[3];
+    memcpy(&bits[0], &player->x, 4);
+    memcpy(&bits[1], &player->y, 4);
+    memcpy(&bits[2], &player->angle, 4);
+    Uint64 hash = simMap->hash;
+    for (int i = 0; i < 3; i++) {
+        hash = mixHash(hash ^ bits[i]);
+    }
+    return hash;
+}
+
+bool startRecording(InputRecorder* rec, const char* path, Player* player) {
+    rec->file = fopen(path, "wb");
+    rec->runLength = 0;
+    if (rec->file == NULL) {
+        printf("Could not create recording %s\n", path);
+        return false;
+    }
+    Uint8 header[RECORD_HEADER_SIZE];
+    memcpy(header, RECORD_MAGIC, 4);
+    writeU16(header + 4, RECORD_VERSION);
+    writeU16(header + 6, 0);
+    writeU32(header + 8, crc32(map.tiles, (size_t)map.width * map.height));
+    writeF32(header + 12, player->x);
+    writeF32(header + 16, player->y);
+    writeF32(header + 20, player->angle);
+    fwrite(header, 1, RECORD_HEADER_SIZE, rec->file);
+    return true;
+}
+
+void flushRecordRun(InputRecorder* rec) {
+    if (rec->runLength > 0) {
+        Uint8 record[2] = { rec->buttons, (Uint8)rec->runLength };
+        fwrite(record, 1, 2, rec->file);
+        rec->runLength = 0;
+    }
+}
+
+void recordTick(InputRecorder* rec, TickInput* input) {
+    if (input->editCount == 0) {
+        if (rec->runLength > 0 && (rec->buttons != input->buttons || rec->runLength == 255)) {
+            flushRecordRun(rec);
+        }
+        rec->buttons = input->buttons;
+        rec->runLength++;
+        return;
+    }
+
+    flushRecordRun(rec);
+    Uint8 record[3 + MAX_TICK_EDITS * 4];
+    record[0] = input->buttons | RECORD_HAS_EDITS;
+    record[1] = 1;
+    record[2] = input->editCount;
+    for (int i = 0; i < input->editCount; i++) {
+        writeU16(record + 3 + i * 4, input->edits[i].x);
+        writeU16(record + 5 + i * 4, input->edits[i].y);
+    }
+    fwrite(record, 1, 3 + input->editCount * 4, rec->file);
+}
+
+void stopRecording(InputRecorder* rec) {
+    flushRecordRun(rec);
+    fclose(rec->file);
+    rec->file = NULL;
+}
+
+bool openReplay(InputReplay* replay, const char* path, Player* player) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Could not open recording %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    replay->data = size > 0 ? malloc(size) : NULL;
+    if (replay->data == NULL || fread(replay->data, 1, size, file) != (size_t)size) {
+        printf("Could not read recording %s\n", path);
+        free(replay->data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    // Version 1 is the same, it just never has INPUT_TERRAIN set
+    if (size < RECORD_HEADER_SIZE || memcmp(replay->data, RECORD_MAGIC, 4) != 0 ||
+        readU16(replay->data + 4) < 1 || readU16(replay->data + 4) > RECORD_VERSION) {
+        printf("%s is not a version 1 to %d recording\n", path, RECORD_VERSION);
+        free(replay->data);
+        return false;
+    }
+    if (readU32(replay->data + 8) != crc32(map.tiles, (size_t)map.width * map.height)) {
+        printf("Warning: %s was recorded on a different map\n", path);
+    }
+    readF32Bits(replay->data + 12, &player->x);
+    readF32Bits(replay->data + 16, &player->y);
+    readF32Bits(replay->data + 20, &player->angle);
+    replay->size = size;
+    replay->pos = RECORD_HEADER_SIZE;
+    replay->runLeft = 0;
+    return true;
+}
+
+// Fill in the next tick from the recording; returns false once it runs out
+bool replayTick(InputReplay* replay, TickInput* input) {
+    input->editCount = 0;
+    if (replay->runLeft > 0) {
+        input->buttons = replay->buttons;
+        replay->runLeft--;
+        return true;
+    }
+    if (replay->pos + 2 > replay->size) {
+        return false;
+    }
+
+    Uint8 buttons = replay->data[replay->pos];
+    int count = replay->data[replay->pos + 1];
+    replay->pos += 2;
+    input->buttons = buttons & ~RECORD_HAS_EDITS;
+    if (buttons & RECORD_HAS_EDITS) {
+        if (replay->pos + 1 > replay->size) return false;
+        int editCount = replay->data[replay->pos++];
+        if (editCount > MAX_TICK_EDITS || replay->pos + editCount * 4 > replay->size) return false;
+        for (int i = 0; i < editCount; i++) {
+            input->edits[i].x = readU16(replay->data + replay->pos);
+            input->edits[i].y = readU16(replay->data + replay->pos + 2);
+            replay->pos += 4;
+        }
+        input->editCount = editCount;
+    }
+    replay->buttons = input->buttons;
+    replay->runLeft = count - 1;
+    return count > 0;
+}
+
+float castRayHit(Player* player, float rayAngle, RayHit* hit) {
+    float rayX = player->x;
+    float rayY = player->y;
+    float prevX = rayX;
+    float prevY = rayY;
+    float stepX = cos(rayAngle * M_PI / 180);
+    float stepY = sin(rayAngle * M_PI / 180);
+    float distance = 0;
+
+    while (!isWall(rayX, rayY) && distance < SCREEN_WIDTH) {
+        // A wall at least d tiles away (in both axes) leaves d - 1 whole tiles
+        // of open space, so the ray can jump across them in one step
+        int step = 1;
+        int mapX = (int)rayX / TILE_SIZE;
+        int mapY = (int)rayY / TILE_SIZE;
+        if (rayX >= 0 && rayY >= 0 && mapX < map.width && mapY < map.height) {
+            int d = map.distField[mapY * map.width + mapX];
+            if (d > 1) {
+                step = (d - 1) * TILE_SIZE;
+                if (distance + step > SCREEN_WIDTH) step = SCREEN_WIDTH - distance;
+                if (step < 1) step = 1;
+            }
+        }
+        prevX = rayX;
+        prevY = rayY;
+        rayX += stepX * step;
+        rayY += stepY * step;
+        distance += step;
+    }
+
+    hit->distance = distance;
+    hit->mapX = -1;
+    if (isWall(rayX, rayY)) {
+        // The last step is always a single unit, so the tile it came from tells
+        // which face was crossed
+        int hitX = (int)rayX / TILE_SIZE;
+        int hitY = (int)rayY / TILE_SIZE;
+        int fromX = (int)prevX / TILE_SIZE;
+        hit->mapX = hitX;
+        hit->mapY = hitY;
+        if (fromX != hitX) {
+            hit->face = hitX > fromX ? 0 : 1;
+            hit->u = fmodf(rayY, TILE_SIZE) / TILE_SIZE;
+        } else {
+            hit->face = (int)rayY / TILE_SIZE > (int)prevY / TILE_SIZE ? 2 : 3;
+            hit->u = fmodf(rayX, TILE_SIZE) / TILE_SIZE;
+        }
+    }
+    return distance;
+}
+
+float columnAngle(Player* player, int column) {
+    return player->angle - (FOV / 2) + ((float)column / NUM_RAYS) * FOV;
+}
+
+bool nearEdge(double v, double period, double guard) {
+    double f = v - floor(v / period) * period;
+    return f < guard || f > period - guard;
+}
+
+// Find where the ray meets the wall plane that the span's edge rays hit, the way
+// castRayHit would: the first whole step inside the wall. The cross-plane tiles
+// lo..hi are known to be walls with open space in front. Returns false when the
+// march could come out differently, and the ray has to be cast after all.
+bool interpolateHit(Player* player, float rayAngle, RayHit* edge, int lo, int hi, RayHit* hit) {
+    float stepX = cos(rayAngle * M_PI / 180);
+    float stepY = sin(rayAngle * M_PI / 180);
+    bool xPlane = edge->face < 2;
+    double along = xPlane ? stepX : stepY;
+    double across = xPlane ? stepY : stepX;
+    double start = xPlane ? player->x : player->y;
+    double side = xPlane ? player->y : player->x;
+    int plane = xPlane ? edge->mapX : edge->mapY;
+
+    double edgeAt;
+    int n;
+    if (edge->face == 0 || edge->face == 2) {
+        if (along <= 0) return false;
+        edgeAt = plane * TILE_SIZE;
+        n = (int)ceil((edgeAt - start) / along);
+    } else {
+        if (along >= 0) return false;
+        edgeAt = (plane + 1) * TILE_SIZE;
+        n = (int)floor((edgeAt - start) / along) + 1;
+    }
+    if (n < 1 || n >= SCREEN_WIDTH) return false;
+    double pos = start + n * along;
+    double cross = side + n * across;
+    double prevCross = cross - across;
+    if (cross < 0 || prevCross < 0) return false;
+    int tile = (int)cross / TILE_SIZE;
+    if (tile < lo || tile > hi || (int)prevCross / TILE_SIZE != tile) return false;
+
+    // The march adds up its steps in floats, so where this step or the one
+    // before lands within rounding distance of a tile or texel edge it can
+    // come out on the other side. Each of its (at most n) steps can round the
+    // position off by a float epsilon of its size, so far hits get more room.
+    double guard = RAY_GUARD + n * FLT_EPSILON * (fabs(start) + fabs(side) + n);
+    if (fabs(pos - edgeAt) < guard || fabs(pos - along - edgeAt) < guard ||
+        nearEdge(cross, 1, guard) || nearEdge(prevCross, TILE_SIZE, guard)) {
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+        if (rayTolerance <= 0 || n < 2 || WALL_HEIGHT / ((n - 1) * (float)n * cosRel) > rayTolerance) {
+            return false;
+        }
+    }
+
+    hit->distance = n;
+    hit->mapX = xPlane ? plane : tile;
+    hit->mapY = xPlane ? tile : plane;
+    hit->face = edge->face;
+    hit->u = fmodf((float)cross, TILE_SIZE) / TILE_SIZE;
+    return true;
+}
+
+// True if both hits are on the same wall plane and every tile of that plane
+// between them is a wall with open space in front; lo..hi are those tiles
+bool samePlane(RayHit* a, RayHit* b, int* lo, int* hi) {
+    if (a->mapX < 0 || b->mapX < 0 || a->face != b->face) {
+        return false;
+    }
+    bool xPlane = a->face < 2;
+    int plane = xPlane ? a->mapX : a->mapY;
+    if (plane != (xPlane ? b->mapX : b->mapY)) {
+        return false;
+    }
+    int front = (a->face == 0 || a->face == 2) ? plane - 1 : plane + 1;
+    int ta = xPlane ? a->mapY : a->mapX;
+    int tb = xPlane ? b->mapY : b->mapX;
+    *lo = ta < tb ? ta : tb;
+    *hi = ta < tb ? tb : ta;
+    for (int t = *lo; t <= *hi; t++) {
+        int wallX = xPlane ? plane : t, wallY = xPlane ? t : plane;
+        int frontX = xPlane ? front : t, frontY = xPlane ? t : front;
+        if (!isWallIn(&map, wallX * TILE_SIZE, wallY * TILE_SIZE) || isWallIn(&map, frontX * TILE_SIZE, frontY * TILE_SIZE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Columns a and b are cast; fill in the ones between
+void fillSpan(Player* player, RayHit* hits, int a, int b) {
+    if (b - a < 2) {
+        return;
+    }
+    int lo, hi;
+    if (samePlane(&hits[a], &hits[b], &lo, &hi)) {
+        for (int i = a + 1; i < b; i++) {
+            float rayAngle = columnAngle(player, i);
+            if (!interpolateHit(player, rayAngle, &hits[a], lo, hi, &hits[i])) {
+                castRayHit(player, rayAngle, &hits[i]);
+            }
+        }
+        return;
+    }
+    int mid = (a + b) / 2;
+    castRayHit(player, columnAngle(player, mid), &hits[mid]);
+    fillSpan(player, hits, a, mid);
+    fillSpan(player, hits, mid, b);
+}
+
+// Ray hits for every screen column. In adaptive mode most columns on large
+// flat walls are interpolated instead of cast; with no tolerance the result is
+// the same as casting them all.
+void castColumns(Player* player, RayHit* hits) {
+    if (!adaptiveRays || rayStep < 2) {
+        for (int i = 0; i < NUM_RAYS; i++) {
+            castRayHit(player, columnAngle(player, i), &hits[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < NUM_RAYS; i += rayStep) {
+        castRayHit(player, columnAngle(player, i), &hits[i]);
+    }
+    int last = NUM_RAYS - 1;
+    if (last % rayStep != 0) {
+        castRayHit(player, columnAngle(player, last), &hits[last]);
+    }
+    for (int a = 0; a < last; a += rayStep) {
+        fillSpan(player, hits, a, a + rayStep < last ? a + rayStep : last);
+    }
+}
+
+float castRay(Player* player, float rayAngle) {
+    RayHit hit;
+    return castRayHit(player, rayAngle, &hit);
+}
+
+int wallLight(RayHit* hit) {
+    if (map.lightCount == 0 || hit->mapX < 0) {
+        return 255;
+    }
+    int texel = (int)(hit->u * LIGHTMAP_FACE_RES);
+    if (texel >= LIGHTMAP_FACE_RES) texel = LIGHTMAP_FACE_RES - 1;
+    size_t tile = (size_t)hit->mapY * map.width + hit->mapX;
+    return lightmaps.wall[(tile * 4 + hit->face) * LIGHTMAP_FACE_RES + texel];
+}
+
+int floorLight(float x, float y) {
+    int tileX = (int)floorf(x / TILE_SIZE);
+    int tileY = (int)floorf(y / TILE_SIZE);
+    if (tileX < 0 || tileX >= map.width || tileY < 0 || tileY >= map.height) {
+        return AMBIENT_LIGHT;
+    }
+    int fx = (int)((x - tileX * TILE_SIZE) * LIGHTMAP_FLOOR_RES / TILE_SIZE);
+    int fy = (int)((y - tileY * TILE_SIZE) * LIGHTMAP_FLOOR_RES / TILE_SIZE);
+    size_t tile = (size_t)tileY * map.width + tileX;
+    return lightmaps.floor[tile * LIGHTMAP_FLOOR_RES * LIGHTMAP_FLOOR_RES + fy * LIGHTMAP_FLOOR_RES + fx];
+}
+
+Uint32 rgb(int r, int g, int b) {
+    return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+// Fill the palette with 64-step ramps and draw the textures with it
+void buildPaletteAndTextures(void) {
+    for (int i = 0; i < 64; i++) {
+        palette[PALETTE_GREY + i] = rgb(i * 4, i * 4, i * 4);
+        palette[PALETTE_BRICK + i] = rgb(i * 4, i * 2, i * 3 / 2);
+        palette[PALETTE_FLOOR + i] = rgb(i * 100 / 63, i * 50 / 63, i * 50 / 63);
+        palette[PALETTE_CEILING + i] = rgb(i * 50 / 63, i * 50 / 63, i * 100 / 63);
+    }
+
+    // Bricks 32x16 with every other row offset by half a brick, 2px mortar
+    Uint32 seed = 12345;
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) % 12;
+            int bx = (x + ((y / 16) % 2) * 16) % 32;
+            bool mortar = (y % 16) < 2 || bx < 2;
+            wallTexture[x][y] = mortar ? PALETTE_GREY + 40 + noise / 2 : PALETTE_BRICK + 48 + noise;
+        }
+    }
+
+    // Large floor tiles with thin grout lines
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) % 6;
+            bool grout = (x % 32) == 0 || (y % 32) == 0;
+            bool dark = ((x / 32) + (y / 32)) % 2;
+            floorTexture[y][x] = grout ? PALETTE_GREY + 20 : PALETTE_FLOOR + (dark ? 50 : 60) + noise - 3;
+        }
+    }
+}
+
+// Precompute every palette colour at every light level. The number of levels is
+// the quality setting; the per-pixel cost is the same either way.
+void buildColormap(int levels) {
+    lightLevels = levels;
+    for (int l = 0; l < levels; l++) {
+        int scale = levels > 1 ? l * 256 / (levels - 1) : 256;
+        for (int c = 0; c < 256; c++) {
+            int r = ((palette[c] >> 16) & 0xFF) * scale >> 8;
+            int g = ((palette[c] >> 8) & 0xFF) * scale >> 8;
+            int b = (palette[c] & 0xFF) * scale >> 8;
+            colormap[l][c] = rgb(r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b);
+        }
+    }
+}
+
+int lightLevel(int light) {
+    return (light * (lightLevels - 1) + 127) / 255;
+}
+
+// Render the 3D view into a 32-bit ARGB buffer using textures and the colormap
+void renderIndexedView(Uint32* pixels, int pitch, Player* player) {
+    int stride = pitch / 4;
+    Uint32 ceiling = colormap[lightLevels - 1][PALETTE_CEILING + 63];
+
+    RayHit hits[NUM_RAYS];
+    castColumns(player, hits);
+
+    SDL_LockMutex(baker.lock);
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = columnAngle(player, i);
+        RayHit hit = hits[i];
+        float distance = hit.distance;
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+
+        // Keep the height finite when the camera is right up against a wall
+        float wallHeight = WALL_HEIGHT / ((distance > 1 ? distance : 1) * cosRel);
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+        int drawTop = wallTop < 0 ? 0 : wallTop;
+        int drawBottom = wallBottom > SCREEN_HEIGHT ? SCREEN_HEIGHT : wallBottom;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+        Uint32* cmap = colormap[lightLevel(shade * wallLight(&hit) / 255)];
+
+        Uint32* out = pixels + i;
+        for (int y = 0; y < drawTop; y++) {
+            out[y * stride] = ceiling;
+        }
+
+        // Wall: step down one texture column in 16.16 fixed point
+        int texX = hit.mapX >= 0 ? (int)(hit.u * TEXTURE_SIZE) & (TEXTURE_SIZE - 1) : 0;
+        Uint8* column = wallTexture[texX];
+        Uint32 texStep = (Uint32)(TEXTURE_SIZE * 65536.0f / (wallHeight > 1 ? wallHeight : 1));
+        Uint32 texPos = (Uint32)((drawTop - wallTop) * texStep);
+        for (int y = drawTop; y < drawBottom; y++) {
+            out[y * stride] = cmap[column[(texPos >> 16) & (TEXTURE_SIZE - 1)]];
+            texPos += texStep;
+        }
+
+        // Floor: project each row back onto the map for its texel and light
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        int floorTop = drawBottom < SCREEN_HEIGHT / 2 ? SCREEN_HEIGHT / 2 : drawBottom;
+        for (int y = drawBottom; y < floorTop; y++) {
+            out[y * stride] = ceiling;
+        }
+        for (int y = floorTop; y < SCREEN_HEIGHT; y++) {
+            float rowDistance = WALL_HEIGHT / (2 * (y + 0.5f - SCREEN_HEIGHT / 2) * cosRel);
+            float worldX = player->x + dirX * rowDistance;
+            float worldY = player->y + dirY * rowDistance;
+            int floorShade = 255 - (int)(rowDistance * 255 / SCREEN_WIDTH);
+            floorShade = floorShade < 0 ? 0 : floorShade;
+            int light = map.lightCount > 0 ? floorLight(worldX, worldY) : 255;
+            int tx = (int)worldX & (TEXTURE_SIZE - 1);
+            int ty = (int)worldY & (TEXTURE_SIZE - 1);
+            out[y * stride] = colormap[lightLevel(floorShade * light / 255)][floorTexture[ty][tx]];
+        }
+    }
+    SDL_UnlockMutex(baker.lock);
+}
+
+// Screen row of height z (in standard walls) at perpendicular distance p
+float projectHeight(float z, float p) {
+    return SCREEN_HEIGHT / 2 - (z - EYE_HEIGHT) * WALL_HEIGHT / p;
+}
+
+int firstRowBelow(float y) {
+    return (int)ceilf(y - 0.5f);
+}
+
+// Variable-height view. Each ray walks the grid front to back (DDA) and draws
+// the front face and top of every block it passes. All blocks stand on the
+// ground, so nearer ones always cover the screen from the bottom up and one
+// "bottom" row per column is the whole coverage buffer: every pixel is written
+// once, and a ray stops as soon as nothing further away can show above it.
+void renderHeightView(Uint32* pixels, int pitch, Player* player) {
+    int stride = pitch / 4;
+    Uint32 ceiling = colormap[lightLevels - 1][PALETTE_CEILING + 63];
+    Uint32 farGround = colormap[0][PALETTE_FLOOR + 50];
+    float maxTopZ = (float)map.maxTop / HEIGHT_UNITS;
+
+    SDL_LockMutex(baker.lock);
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        Uint32* out = pixels + i;
+        int bottom = SCREEN_HEIGHT;  // Rows [0, bottom) are still uncovered
+
+        int mapX = (int)floorf(player->x / TILE_SIZE);
+        int mapY = (int)floorf(player->y / TILE_SIZE);
+        int stepX = dirX > 0 ? 1 : -1;
+        int stepY = dirY > 0 ? 1 : -1;
+        float deltaX = dirX != 0 ? fabsf(TILE_SIZE / dirX) : INFINITY;
+        float deltaY = dirY != 0 ? fabsf(TILE_SIZE / dirY) : INFINITY;
+        float sideX = dirX > 0 ? ((mapX + 1) * TILE_SIZE - player->x) / dirX : dirX < 0 ? (mapX * TILE_SIZE - player->x) / dirX : INFINITY;
+        float sideY = dirY > 0 ? ((mapY + 1) * TILE_SIZE - player->y) / dirY : dirY < 0 ? (mapY * TILE_SIZE - player->y) / dirY : INFINITY;
+        float entry = 0;
+        int face = -1;  // Face the ray came in through, -1 in the player's own tile
+
+        while (bottom > 0 && entry < MAX_VIEW_DISTANCE) {
+            if (mapX < 0 || mapX >= map.width || mapY < 0 || mapY >= map.height) break;
+            size_t index = (size_t)mapY * map.width + mapX;
+            float exit = fminf(sideX, sideY);
+            float near = fmaxf(entry * cosRel, 1);
+            float far = fmaxf(exit * cosRel, 1);
+            bool wall = map.tiles[index] == 1;
+            float top = (float)blockTop(&map, index) / HEIGHT_UNITS;
+
+            // Front face, from the ground up to the top of the block
+            if (face >= 0 && top > 0) {
+                int y0 = firstRowBelow(projectHeight(top, near));
+                int y1 = firstRowBelow(projectHeight(0, near));
+                if (y0 < 0) y0 = 0;
+                if (y1 > bottom) y1 = bottom;
+                if (y0 < y1) {
+                    float hitX = player->x + dirX * entry;
+                    float hitY = player->y + dirY * entry;
+                    RayHit hit = { entry, mapX, mapY, face, 0 };
+                    hit.u = fmodf(face < 2 ? hitY : hitX, TILE_SIZE) / TILE_SIZE;
+                    int texX = (int)(hit.u * TEXTURE_SIZE) & (TEXTURE_SIZE - 1);
+                    Uint8* column = wall ? wallTexture[texX] : floorTexture[texX];
+                    int shade = 255 - (int)(entry * 255 / SCREEN_WIDTH);
+                    shade = shade < 0 ? 0 : shade;
+                    int light = wall ? wallLight(&hit) : (map.lightCount > 0 ? floorLight(hitX - dirX, hitY - dirY) : 255);
+                    Uint32* cmap = colormap[lightLevel(shade * light / 255)];
+                    for (int y = y0; y < y1; y++) {
+                        float z = EYE_HEIGHT + (SCREEN_HEIGHT / 2 - (y + 0.5f)) * near / WALL_HEIGHT;
+                        int texY = (int)((top - z) * TEXTURE_SIZE) & (TEXTURE_SIZE - 1);
+                        out[y * stride] = cmap[column[texY]];
+                    }
+                    bottom = y0;
+                }
+            }
+
+            // Top of the block, only visible when it is below the eye
+            if (top < EYE_HEIGHT) {
+                int y0 = firstRowBelow(projectHeight(top, far));
+                int y1 = firstRowBelow(projectHeight(top, near));
+                if (y0 < 0) y0 = 0;
+                if (y1 > bottom) y1 = bottom;
+                for (int y = y0; y < y1; y++) {
+                    float rowDistance = (EYE_HEIGHT - top) * WALL_HEIGHT / ((y + 0.5f - SCREEN_HEIGHT / 2) * cosRel);
+                    float worldX = player->x + dirX * rowDistance;
+                    float worldY = player->y + dirY * rowDistance;
+                    int shade = 255 - (int)(rowDistance * 255 / SCREEN_WIDTH);
+                    shade = shade < 0 ? 0 : shade;
+                    int light = map.lightCount > 0 ? floorLight(worldX, worldY) : 255;
+                    int tx = (int)worldX & (TEXTURE_SIZE - 1);
+                    int ty = (int)worldY & (TEXTURE_SIZE - 1);
+                    Uint8 texel = wall ? wallTexture[tx][ty] : floorTexture[ty][tx];
+                    out[y * stride] = colormap[lightLevel(shade * light / 255)][texel];
+                }
+                if (y0 < y1) {
+                    bottom = y0;
+                }
+            }
+
+            // Stop once even the tallest block further away would stay hidden
+            float reach = maxTopZ > EYE_HEIGHT ? projectHeight(maxTopZ, far) : SCREEN_HEIGHT / 2;
+            if (bottom <= reach) break;
+
+            if (sideX < sideY) {
+                entry = sideX;
+                sideX += deltaX;
+                mapX += stepX;
+                face = stepX > 0 ? 0 : 1;
+            } else {
+                entry = sideY;
+                sideY += deltaY;
+                mapY += stepY;
+                face = stepY > 0 ? 2 : 3;
+            }
+        }
+
+        // Whatever is left is sky above the horizon and unlit ground below it
+        for (int y = 0; y < bottom; y++) {
+            out[y * stride] = y < SCREEN_HEIGHT / 2 ? ceiling : farGround;
+        }
+    }
+    SDL_UnlockMutex(baker.lock);
+}
+
+void freeTerrain(Terrain* t) {
+    free(t->height);
+    free(t->color);
+    t->height = NULL;
+    t->color = NULL;
+}
+
+// Diamond-square fractal heightmap, coloured by height and lit from the west
+bool generateTerrain(Terrain* t, int size, Uint32 seed) {
+    t->size = size;
+    t->height = malloc((size_t)size * size);
+    t->color = malloc((size_t)size * size * sizeof(Uint32));
+    float* h = malloc((size_t)size * size * sizeof(float));
+    if (t->height == NULL || t->color == NULL || h == NULL) {
+        free(h);
+        freeTerrain(t);
+        return false;
+    }
+
+    int mask = size - 1;
+    h[0] = 0.5f;
+    float roughness = 0.5f;
+    for (int step = size; step > 1; step /= 2) {
+        int half = step / 2;
+        for (int y = 0; y < size; y += step) {
+            for (int x = 0; x < size; x += step) {
+                float avg = (h[y * size + x] + h[y * size + ((x + step) & mask)] +
+                             h[((y + step) & mask) * size + x] + h[((y + step) & mask) * size + ((x + step) & mask)]) / 4;
+                seed = seed * 1103515245 + 12345;
+                h[(y + half) * size + x + half] = avg + ((seed >> 8) % 1000 / 1000.0f - 0.5f) * roughness;
+            }
+        }
+        for (int y = 0; y < size; y += half) {
+            for (int x = (y / half % 2 == 0) ? half : 0; x < size; x += step) {
+                float avg = (h[y * size + ((x - half) & mask)] + h[y * size + ((x + half) & mask)] +
+                             h[((y - half) & mask) * size + x] + h[((y + half) & mask) * size + x]) / 4;
+                seed = seed * 1103515245 + 12345;
+                h[y * size + x] = avg + ((seed >> 8) % 1000 / 1000.0f - 0.5f) * roughness;
+            }
+        }
+        roughness *= 0.55f;
+    }
+
+    float lo = h[0], hi = h[0];
+    for (int i = 0; i < size * size; i++) {
+        if (h[i] < lo) lo = h[i];
+        if (h[i] > hi) hi = h[i];
+    }
+    for (int i = 0; i < size * size; i++) {
+        t->height[i] = (Uint8)((h[i] - lo) / (hi - lo + 1e-6f) * 255);
+    }
+    free(h);
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            int v = t->height[y * size + x];
+            int r, g, b;
+            if (v < 70) { r = 30; g = 60; b = 140; }            // Water
+            else if (v < 85) { r = 190; g = 170; b = 120; }     // Sand
+            else if (v < 170) { r = 50; g = 120; b = 40; }      // Grass
+            else if (v < 220) { r = 110; g = 100; b = 90; }     // Rock
+            else { r = 240; g = 240; b = 245; }                 // Snow
+            int slope = v - t->height[y * size + ((x - 1) & mask)];
+            int lit = 200 + slope * 12;
+            lit = lit < 80 ? 80 : lit > 280 ? 280 : lit;
+            r = r * lit / 200;
+            g = g * lit / 200;
+            b = b * lit / 200;
+            t->color[y * size + x] = rgb(r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b);
+        }
+    }
+    return true;
+}
+
+// Read one header number from a binary PGM/PPM file, skipping comments
+int readPnmNumber(FILE* file) {
+    int c = fgetc(file);
+    while (c == '#' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        if (c == '#') {
+            while (c != '\n' && c != EOF) c = fgetc(file);
+        }
+        c = fgetc(file);
+    }
+    int value = 0;
+    while (c >= '0' && c <= '9') {
+        value = value * 10 + (c - '0');
+        c = fgetc(file);
+    }
+    return value;
+}
+
+// Load a square power-of-two heightmap (P5 PGM) and colour map (P6 PPM)
+bool loadTerrain(Terrain* t, const char* heightPath, const char* colorPath) {
+    FILE* hf = fopen(heightPath, "rb");
+    FILE* cf = fopen(colorPath, "rb");
+    char hm[2] = { 0 }, cm[2] = { 0 };
+    if (hf == NULL || cf == NULL || fread(hm, 1, 2, hf) != 2 || fread(cm, 1, 2, cf) != 2 ||
+        memcmp(hm, "P5", 2) != 0 || memcmp(cm, "P6", 2) != 0) {
+        printf("Terrain needs a P5 heightmap and a P6 colour map\n");
+        if (hf) fclose(hf);
+        if (cf) fclose(cf);
+        return false;
+    }
+    int w = readPnmNumber(hf), h = readPnmNumber(hf), maxH = readPnmNumber(hf);
+    int cw = readPnmNumber(cf), ch = readPnmNumber(cf), maxC = readPnmNumber(cf);
+    if (w != h || cw != w || ch != h || w <= 0 || (w & (w - 1)) != 0 || w > MAX_MAP_SIDE || maxH != 255 || maxC != 255) {
+        printf("Terrain maps must be the same square power-of-two size with 8-bit samples\n");
+        fclose(hf);
+        fclose(cf);
+        return false;
+    }
+
+    size_t count = (size_t)w * h;
+    t->size = w;
+    t->height = malloc(count);
+    t->color = malloc(count * sizeof(Uint32));
+    Uint8* rgbData = malloc(count * 3);
+    bool ok = t->height != NULL && t->color != NULL && rgbData != NULL &&
+              fread(t->height, 1, count, hf) == count && fread(rgbData, 1, count * 3, cf) == count * 3;
+    if (ok) {
+        for (size_t i = 0; i < count; i++) {
+            t->color[i] = rgb(rgbData[i * 3], rgbData[i * 3 + 1], rgbData[i * 3 + 2]);
+        }
+    } else {
+        printf("Could not read terrain maps %s and %s\n", heightPath, colorPath);
+    }
+    free(rgbData);
+    fclose(hf);
+    fclose(cf);
+    return ok;
+}
+
+// Generate the terrain if there is none yet. Gives up for good when there
+// isn't enough memory.
+bool terrainReady(void) {
+    static bool failed = false;
+    if (terrain.height == NULL && !failed && !generateTerrain(&terrain, TERRAIN_SIZE, 1)) {
+        printf("Not enough memory for the terrain\n");
+        failed = true;
+    }
+    return terrain.height != NULL;
+}
+
+// Terrain view, using the same per-column ray angles as the wall renderers.
+// Each column is marched front to back; "top" is the highest row drawn so far,
+// so anything further away only draws what pokes out above it. The sample
+// step grows with distance, trading detail far away for speed.
+void renderTerrainView(Uint32* pixels, int pitch, Player* player) {
+    if (!terrainReady()) {
+        return;
+    }
+    int stride = pitch / 4;
+    int mask = terrain.size - 1;
+    Uint32 sky = colormap[lightLevels - 1][PALETTE_CEILING + 63];
+    int px = (int)floorf(player->x) & mask;
+    int py = (int)floorf(player->y) & mask;
+    float cameraHeight = terrain.height[py * terrain.size + px] + TERRAIN_CAMERA_HEIGHT;
+
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = player->angle - (FOV / 2) + ((float)i / NUM_RAYS) * FOV;
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        Uint32* out = pixels + i;
+        int top = SCREEN_HEIGHT;
+
+        float distance = 1;
+        while (distance < TERRAIN_DISTANCE && top > 0) {
+            int sx = (int)floorf(player->x + dirX * distance) & mask;
+            int sy = (int)floorf(player->y + dirY * distance) & mask;
+            size_t index = (size_t)sy * terrain.size + sx;
+            float depth = distance * cosRel;
+            int y = (int)((cameraHeight - terrain.height[index]) * TERRAIN_SCALE / depth) + SCREEN_HEIGHT / 2;
+            if (y < 0) y = 0;
+            if (y < top) {
+                // Fade into the sky colour with distance
+                Uint32 c = terrain.color[index];
+                int fog = (int)(distance * 256 / TERRAIN_DISTANCE);
+                int r = (((c >> 16) & 0xFF) * (256 - fog) + ((sky >> 16) & 0xFF) * fog) >> 8;
+                int g = (((c >> 8) & 0xFF) * (256 - fog) + ((sky >> 8) & 0xFF) * fog) >> 8;
+                int b = ((c & 0xFF) * (256 - fog) + (sky & 0xFF) * fog) >> 8;
+                Uint32 color = rgb(r, g, b);
+                for (int row = y; row < top; row++) {
+                    out[row * stride] = color;
+                }
+                top = y;
+            }
+            distance += 1 + distance * TERRAIN_LOD;
+        }
+        for (int row = 0; row < top; row++) {
+            out[row * stride] = sky;
+        }
+    }
+}
+
+// Player marker and rays drawn on top of the 3D view
+void renderOverlay(SDL_Renderer* renderer, Player* player) {
+    // Render the player
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255); // Green for player
+    SDL_Rect playerRect = { (int)(player->x - 5), (int)(player->y - 5), 10, 10 };
+    SDL_RenderFillRect(renderer, &playerRect);
+
+    // Render rays
+    RayHit hits[NUM_RAYS];
+    castColumns(player, hits);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255); // Yellow for rays
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = columnAngle(player, i);
+        float distance = hits[i].distance;
+        float rayX = player->x + cos(rayAngle * M_PI / 180) * distance;
+        float rayY = player->y + sin(rayAngle * M_PI / 180) * distance;
+        SDL_RenderDrawLine(renderer, player->x, player->y, rayX, rayY);
+    }
+}
+
+void render3DView(SDL_Renderer* renderer, Player* player) {
+    RayHit hits[NUM_RAYS];
+    castColumns(player, hits);
+
+    // Keep the bake thread from publishing lightmaps halfway through a frame
+    SDL_LockMutex(baker.lock);
+    for (int i = 0; i < NUM_RAYS; i++) {
+        float rayAngle = columnAngle(player, i);
+        RayHit hit = hits[i];
+        float distance = hit.distance;
+        float cosRel = cos((rayAngle - player->angle) * M_PI / 180);
+
+        float wallHeight = WALL_HEIGHT / (distance * cosRel);
+        int wallTop = (SCREEN_HEIGHT / 2) - (wallHeight / 2);
+        int wallBottom = wallTop + wallHeight;
+
+        int shade = 255 - (int)(distance * 255 / SCREEN_WIDTH);
+        shade = shade < 0 ? 0 : shade;
+        shade = shade * wallLight(&hit) / 255;
+
+        // Render ceiling (roof)
+        SDL_SetRenderDrawColor(renderer, 50, 50, 100, 255);
+        SDL_RenderDrawLine(renderer, i, 0, i, wallTop);
+
+        // Render wall
+        SDL_SetRenderDrawColor(renderer, shade, shade, shade, 255);
+        SDL_RenderDrawLine(renderer, i, wallTop, i, wallBottom);
+
+        // Render floor
+        if (map.lightCount == 0) {
+            SDL_SetRenderDrawColor(renderer, 100, 50, 50, 255);
+            SDL_RenderDrawLine(renderer, i, wallBottom, i, SCREEN_HEIGHT);
+            continue;
+        }
+        // Project each floor row back onto the map and draw runs of rows that
+        // share a lightmap texel as one line
+        float dirX = cos(rayAngle * M_PI / 180);
+        float dirY = sin(rayAngle * M_PI / 180);
+        int runStart = wallBottom < SCREEN_HEIGHT / 2 ? SCREEN_HEIGHT / 2 : wallBottom;
+        int runLight = -1;
+        for (int y = runStart; y <= SCREEN_HEIGHT; y++) {
+            int light = runLight;
+            if (y < SCREEN_HEIGHT) {
+                float rowDistance = WALL_HEIGHT / (2 * (y + 0.5f - SCREEN_HEIGHT / 2) * cosRel);
+                light = floorLight(player->x + dirX * rowDistance, player->y + dirY * rowDistance);
+            }
+            if (light != runLight || y == SCREEN_HEIGHT) {
+                if (runLight >= 0) {
+                    SDL_SetRenderDrawColor(renderer, 100 * runLight / 255, 50 * runLight / 255, 50 * runLight / 255, 255);
+                    SDL_RenderDrawLine(renderer, i, runStart, i, y - 1);
+                }
+                runStart = y;
+                runLight = light;
+            }
+        }
+    }
+    SDL_UnlockMutex(baker.lock);
+
+    renderOverlay(renderer, player);
+}
+
+void renderMap(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) == 1) {
+                SDL_Rect wallRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+                SDL_RenderFillRect(renderer, &wallRect);
+            }
+        }
+    }
+}
+
+void renderMapEditor(SDL_Renderer* renderer) {
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            SDL_Rect tileRect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+            if (getTile(x, y) == 1) {
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255); // Wall (1) - Red
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Empty (0) - White
+            }
+            SDL_RenderFillRect(renderer, &tileRect);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Black border
+            SDL_RenderDrawRect(renderer, &tileRect);
+        }
+    }
+}
+
+// Convert a rendered ARGB frame and write it out. Only integer math is used, so
+// the output is byte-exact no matter how fast the host is.
+bool writeFrame(VideoExport* ex, SDL_Surface* surface) {
+    int w = surface->w;
+    int h = surface->h;
+    Uint8* out = ex->convertBuffer;
+    size_t size;
+
+    if (ex->y4m) {
+        int cw = (w + 1) / 2;
+        int ch = (h + 1) / 2;
+        Uint8* planeY = out + 6;
+        Uint8* planeU = planeY + w * h;
+        Uint8* planeV = planeU + cw * ch;
+        memcpy(out, "FRAME\n", 6);
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+                planeY[y * w + x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            }
+        }
+        for (int cy = 0; cy < ch; cy++) {
+            for (int cx = 0; cx < cw; cx++) {
+                // Average the 2x2 block, clamping at odd edges
+                int r = 0, g = 0, b = 0;
+                for (int k = 0; k < 4; k++) {
+                    int x = cx * 2 + (k & 1);
+                    int y = cy * 2 + (k >> 1);
+                    if (x >= w) x = w - 1;
+                    if (y >= h) y = h - 1;
+                    Uint32 p = ((Uint32*)((Uint8*)surface->pixels + y * surface->pitch))[x];
+                    r += (p >> 16) & 0xFF;
+                    g += (p >> 8) & 0xFF;
+                    b += p & 0xFF;
+                }
+                r = (r + 2) >> 2;
+                g = (g + 2) >> 2;
+                b = (b + 2) >> 2;
+                planeU[cy * cw + cx] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+                planeV[cy * cw + cx] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+            }
+        }
+        size = 6 + (size_t)w * h + 2 * (size_t)cw * ch;
+    } else {
+        int header = sprintf((char*)out, "P6\n%d %d\n255\n", w, h);
+        Uint8* rgb = out + header;
+        for (int y = 0; y < h; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+            for (int x = 0; x < w; x++) {
+                *rgb++ = (row[x] >> 16) & 0xFF;
+                *rgb++ = (row[x] >> 8) & 0xFF;
+                *rgb++ = row[x] & 0xFF;
+            }
+        }
+        size = header + (size_t)w * h * 3;
+    }
+    return fwrite(out, 1, size, ex->file) == size;
+}
+
+int exportWriterThread(void* data) {
+    VideoExport* ex = data;
+    int slot = 0;
+    while (true) {
+        SDL_SemWait(ex->fullSlots);
+        ExportSlot* s = &ex->slots[slot];
+        bool last = s->last;
+        if (!s->empty && !ex->failed && !writeFrame(ex, s->surface)) {
+            ex->failed = true;
+        }
+        SDL_SemPost(ex->freeSlots);
+        slot = (slot + 1) % EXPORT_RING_SIZE;
+        if (last) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// Free what startExport made. Whatever it didn't get to is NULL.
+void freeExportBuffers(VideoExport* ex) {
+    for (int i = 0; i < EXPORT_RING_SIZE; i++) {
+        if (ex->slots[i].renderer != NULL) SDL_DestroyRenderer(ex->slots[i].renderer);
+        if (ex->slots[i].surface != NULL) SDL_FreeSurface(ex->slots[i].surface);
+    }
+    if (ex->freeSlots != NULL) SDL_DestroySemaphore(ex->freeSlots);
+    if (ex->fullSlots != NULL) SDL_DestroySemaphore(ex->fullSlots);
+    free(ex->convertBuffer);
+}
+
+bool startExport(VideoExport* ex, const char* path) {
+    size_t len = strlen(path);
+    ex->y4m = len > 4 && strcmp(path + len - 4, ".y4m") == 0;
+    ex->failed = false;
+    ex->file = fopen(path, "wb");
+    if (ex->file == NULL) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+    if (ex->y4m) {
+        fprintf(ex->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, EXPORT_FPS);
+    }
+    memset(ex->slots, 0, sizeof(ex->slots));
+    ex->freeSlots = NULL;
+    ex->fullSlots = NULL;
+    ex->convertBuffer = malloc(64 + (size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+    bool ok = ex->convertBuffer != NULL;
+    if (!ok) {
+        printf("Not enough memory to export\n");
+    }
+    for (int i = 0; ok && i < EXPORT_RING_SIZE; i++) {
+        ex->slots[i].surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        ex->slots[i].renderer = ex->slots[i].surface ? SDL_CreateSoftwareRenderer(ex->slots[i].surface) : NULL;
+        if (ex->slots[i].renderer == NULL) {
+            printf("Could not create offscreen renderer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (ok) {
+        ex->freeSlots = SDL_CreateSemaphore(EXPORT_RING_SIZE);
+        ex->fullSlots = SDL_CreateSemaphore(0);
+        ex->writer = NULL;
+        if (ex->freeSlots != NULL && ex->fullSlots != NULL) {
+            ex->writer = SDL_CreateThread(exportWriterThread, "export writer", ex);
+        }
+        if (ex->writer == NULL) {
+            printf("Could not start the export writer! SDL_Error: %s\n", SDL_GetError());
+            ok = false;
+        }
+    }
+    if (!ok) {
+        freeExportBuffers(ex);
+        fclose(ex->file);
+        return false;
+    }
+    return true;
+}
+
+// Grab the next free ring slot, blocking only if the writer is a full ring behind
+ExportSlot* beginExportFrame(VideoExport* ex, int frame) {
+    SDL_SemWait(ex->freeSlots);
+    return &ex->slots[frame % EXPORT_RING_SIZE];
+}
+
+void endExportFrame(VideoExport* ex, ExportSlot* slot, bool last) {
+    slot->last = last;
+    SDL_SemPost(ex->fullSlots);
+}
+
+// Let the writer finish without handing it another frame
+void stopExport(VideoExport* ex, int frame) {
+    ExportSlot* slot = beginExportFrame(ex, frame);
+    slot->empty = true;
+    endExportFrame(ex, slot, true);
+}
+
+bool finishExport(VideoExport* ex) {
+    SDL_WaitThread(ex->writer, NULL);
+    freeExportBuffers(ex);
+    if (fclose(ex->file) != 0) {
+        ex->failed = true;
+    }
+    return !ex->failed;
+}
+
+void renderExportFrame(ExportSlot* slot, Player* player) {
+    if (terrainMode) {
+        renderTerrainView(slot->surface->pixels, slot->surface->pitch, player);
+    } else if (heightMode) {
+        renderHeightView(slot->surface->pixels, slot->surface->pitch, player);
+        renderOverlay(slot->renderer, player);
+    } else if (indexedMode) {
+        renderIndexedView(slot->surface->pixels, slot->surface->pitch, player);
+        renderOverlay(slot->renderer, player);
+    } else {
+        SDL_SetRenderDrawColor(slot->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(slot->renderer);
+        render3DView(slot->renderer, player);
+    }
+}
+
+// Camera path files have one "frame x y angle" keyframe per line
+int loadCameraPath(const char* path, PathKey* keys) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Could not open camera path %s\n", path);
+        return 0;
+    }
+    int count = 0;
+    PathKey key;
+    while (count < MAX_PATH_KEYS && fscanf(file, "%d %f %f %f", &key.frame, &key.pose.x, &key.pose.y, &key.pose.angle) == 4) {
+        if (count > 0 && key.frame <= keys[count - 1].frame) {
+            printf("Camera path %s: keyframes must be in increasing frame order\n", path);
+            fclose(file);
+            return 0;
+        }
+        keys[count++] = key;
+    }
+    fclose(file);
+    if (count == 0) {
+        printf("Camera path %s has no keyframes\n", path);
+    }
+    return count;
+}
+
+void cameraPathPose(PathKey* keys, int count, int frame, Player* pose) {
+    int k = 0;
+    while (k + 1 < count && keys[k + 1].frame <= frame) k++;
+    if (k + 1 >= count || frame <= keys[k].frame) {
+        *pose = keys[k].pose;
+        return;
+    }
+    float t = (float)(frame - keys[k].frame) / (keys[k + 1].frame - keys[k].frame);
+    pose->x = keys[k].pose.x + (keys[k + 1].pose.x - keys[k].pose.x) * t;
+    pose->y = keys[k].pose.y + (keys[k + 1].pose.y - keys[k].pose.y) * t;
+    pose->angle = keys[k].pose.angle + (keys[k + 1].pose.angle - keys[k].pose.angle) * t;
+}
+
+// Render a replay or camera path to a video file without opening any windows
+int runExport(const char* exportPath, InputReplay* replay, const char* pathFile, Player* player) {
+    static PathKey keys[MAX_PATH_KEYS];
+    int keyCount = 0;
+    if (pathFile != NULL) {
+        keyCount = loadCameraPath(pathFile, keys);
+        if (keyCount == 0) return 1;
+    }
+
+    VideoExport ex;
+    if (!startExport(&ex, exportPath)) {
+        return 1;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    int frame = 0;
+    bool more = true;
+    TickInput input;
+    while (more) {
+        if (replay->data != NULL) {
+            if (!replayTick(replay, &input)) {
+                // Past the first frame this only happens on a cut-off or
+                // damaged replay, whose last frame wasn't flagged
+                break;
+            }
+            simulateTick(player, &input);
+            // Peek ahead so the final frame can be flagged for the writer
+            more = replay->runLeft > 0 || replay->pos + 2 <= replay->size;
+        } else {
+            cameraPathPose(keys, keyCount, frame, player);
+            more = frame < keys[keyCount - 1].frame;
+        }
+
+        ExportSlot* slot = beginExportFrame(&ex, frame);
+        renderExportFrame(slot, player);
+        endExportFrame(&ex, slot, !more);
+        frame++;
+    }
+    bool cutOff = more && frame > 0;
+    if (cutOff) {
+        stopExport(&ex, frame);
+    }
+    if (frame == 0) {
+        // Empty replay: still hand the writer a frame so it can exit
+        ExportSlot* slot = beginExportFrame(&ex, 0);
+        renderExportFrame(slot, player);
+        endExportFrame(&ex, slot, true);
+        frame = 1;
+    }
+
+    bool ok = finishExport(&ex);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    if (!ok) {
+        printf("Writing %s failed\n", exportPath);
+        return 1;
+    }
+    if (cutOff) {
+        printf("The replay is cut off or damaged, only its first %d frames went to %s\n", frame, exportPath);
+        return 1;
+    }
+    printf("Exported %d frames to %s in %.2f s (%.1f fps)\n", frame, exportPath, seconds, frame / seconds);
+    return 0;
+}
+
+bool createRenderTargets(RenderTargets* targets, SDL_Window* mainWindow, SDL_Window* viewWindow, SDL_Window* editorWindow) {
+    targets->mainRenderer = SDL_CreateRenderer(mainWindow, -1, SDL_RENDERER_ACCELERATED);
+    targets->viewRenderer = SDL_CreateRenderer(viewWindow, -1, SDL_RENDERER_ACCELERATED);
+    targets->editorRenderer = SDL_CreateRenderer(editorWindow, -1, SDL_RENDERER_ACCELERATED);
+    if (targets->mainRenderer == NULL || targets->viewRenderer == NULL || targets->editorRenderer == NULL) {
+        printf("Could not create renderers! SDL_Error: %s\n", SDL_GetError());
+        return false;
+    }
+    targets->viewTexture = SDL_CreateTexture(targets->viewRenderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    return true;
+}
+
+void destroyRenderTargets(RenderTargets* targets) {
+    if (targets->viewTexture != NULL) SDL_DestroyTexture(targets->viewTexture);
+    if (targets->mainRenderer != NULL) SDL_DestroyRenderer(targets->mainRenderer);
+    if (targets->viewRenderer != NULL) SDL_DestroyRenderer(targets->viewRenderer);
+    if (targets->editorRenderer != NULL) SDL_DestroyRenderer(targets->editorRenderer);
+}
+
+// Draw and present all three windows
+void renderWindows(RenderTargets* targets, Player* player) {
+    SDL_Renderer* viewRenderer = targets->viewRenderer;
+
+    // Render the 3D view
+    SDL_SetRenderDrawColor(viewRenderer, 0, 0, 0, 255);
+    SDL_RenderClear(viewRenderer);
+    if (indexedMode || heightMode || terrainMode) {
+        void* pixels;
+        int pitch;
+        if (SDL_LockTexture(targets->viewTexture, NULL, &pixels, &pitch) == 0) {
+            if (terrainMode) {
+                renderTerrainView(pixels, pitch, player);
+            } else if (heightMode) {
+                renderHeightView(pixels, pitch, player);
+            } else {
+                renderIndexedView(pixels, pitch, player);
+            }
+            SDL_UnlockTexture(targets->viewTexture);
+        }
+        SDL_RenderCopy(viewRenderer, targets->viewTexture, NULL, NULL);
+        if (!terrainMode) {
+            renderOverlay(viewRenderer, player);
+        }
+    } else {
+        render3DView(viewRenderer, player);
+    }
+    SDL_RenderPresent(viewRenderer);
+
+    // Render the main game window
+    SDL_SetRenderDrawColor(targets->mainRenderer, 0, 0, 0, 255);
+    SDL_RenderClear(targets->mainRenderer);
+    renderMap(targets->mainRenderer);
+    SDL_RenderPresent(targets->mainRenderer);
+
+    // Render the map editor
+    SDL_SetRenderDrawColor(targets->editorRenderer, 255, 255, 255, 255);
+    SDL_RenderClear(targets->editorRenderer);
+    renderMapEditor(targets->editorRenderer);
+    SDL_RenderPresent(targets->editorRenderer);
+}
+
+void setViewModes(ViewModes* modes) {
+    indexedMode = modes->indexed;
+    heightMode = modes->heights;
+    terrainMode = modes->terrain;
+    adaptiveRays = modes->adaptiveRays;
+}
+
+void publishSnapshot(TripleBuffer* tb, Snapshot* snapshot) {
+    tb->slots[tb->back] = *snapshot;
+    SDL_MemoryBarrierRelease();
+    int old = SDL_AtomicSet(&tb->middle, tb->back | SNAPSHOT_FRESH);
+    tb->back = old & 3;
+}
+
+// The newest published snapshot; fresh is false if it was already seen
+Snapshot* latestSnapshot(TripleBuffer* tb, bool* fresh) {
+    *fresh = false;
+    if (SDL_AtomicGet(&tb->middle) & SNAPSHOT_FRESH) {
+        int old = SDL_AtomicSet(&tb->middle, tb->front);
+        SDL_MemoryBarrierAcquire();
+        tb->front = old & 3;
+        *fresh = true;
+    }
+    return &tb->slots[tb->front];
+}
+
+// Under --threaded the main thread keeps the windows and renderers, which SDL
+// wants on the thread that made them, while the game runs on a thread of its
+// own. This passes events on to the game and draws the newest snapshot
+// whenever one arrives; slow presents only make it skip snapshots, they never
+// hold up the simulation. It owns the real map and everything derived from it.
+void renderLoop(RenderTargets* targets, const char* mapPath) {
+    Uint32 saves = 0;
+    while (true) {
+        forwardEvents(&eventQueue);
+        bool fresh;
+        Snapshot* snapshot = latestSnapshot(&snapshots, &fresh);
+        if (!fresh) {
+            SDL_Delay(1);
+            continue;
+        }
+        applyQueuedEdits(&editQueue, snapshot->mapVersion);
+        if (snapshot->saveRequests != saves) {
+            saves = snapshot->saveRequests;
+            if (saveMapFile(mapPath, &map)) {
+                printf("Saved map to %s\n", mapPath);
+            }
+        }
+        if (snapshot->quit) break;
+        setViewModes(&snapshot->modes);
+        renderWindows(targets, &snapshot->player);
+    }
+}
+
+// Move the player to the first open tile if the start position is inside a wall
+void placePlayer(Player* player) {
+    if (!isWall(player->x, player->y)) return;
+    for (int y = 0; y < map.height; y++) {
+        for (int x = 0; x < map.width; x++) {
+            if (getTile(x, y) != 1) {
+                player->x = x * TILE_SIZE + TILE_SIZE / 2;
+                player->y = y * TILE_SIZE + TILE_SIZE / 2;
+                return;
+            }
+        }
+    }
+}
+
+// What the game loop shares with main
+typedef struct {
+    const char* mapPath;
+    bool threaded;
+    Player player;
+    InputReplay replay;
+    InputRecorder recorder;
+    FILE* hashFile;
+    Uint32 tick;
+    ViewModes modes;
+    Uint32 saveRequests;
+    RenderTargets targets;
+    MapWatch mapWatch;
+} GameLoop;
+
+// Read input and advance the game a tick at a time until quit. Without
+// --threaded this draws every tick as well. With it, this runs on a thread of
+// its own at SIM_TICK_RATE, gets its events from the main thread and hands it
+// snapshots to draw.
+int gameLoop(void* data) {
+    GameLoop* g = data;
+    const char* mapPath = g->mapPath;
+    bool threaded = g->threaded;
+    Player player = g->player;
+    InputReplay replay = g->replay;
+    InputRecorder recorder = g->recorder;
+    FILE* hashFile = g->hashFile;
+    Uint32 tick = g->tick;
+    ViewModes modes = g->modes;
+    Uint32 saveRequests = g->saveRequests;
+    RenderTargets targets = g->targets;
+    MapWatch mapWatch = g->mapWatch;
+    bool quit = false;
+    const Uint8* keystate;
+    SDL_Event e;
+    TickInput input;
+    Uint64 tickLength = SDL_GetPerformanceFrequency() / SIM_TICK_RATE;
+    Uint64 nextTick = SDL_GetPerformanceCounter();
+
+    while (!quit) {
+        input.editCount = 0;
+        while (nextEvent(&e)) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            // Save the map
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2) {
+                if (threaded) {
+                    saveRequests++;
+                } else if (saveMapFile(mapPath, &map)) {
+                    printf("Saved map to %s\n", mapPath);
+                }
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+                modes.indexed = !modes.indexed;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F4) {
+                modes.heights = !modes.heights;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F5) {
+                modes.terrain = !modes.terrain;
+            }
+            if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F6) {
+                modes.adaptiveRays = !modes.adaptiveRays;
+            }
+            // Map editor mouse click handling
+            if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && replay.data == NULL) {
+                int mouseX = e.button.x;
+                int mouseY = e.button.y;
+                int gridX = mouseX / TILE_SIZE;
+                int gridY = mouseY / TILE_SIZE;
+                if (gridX >= 0 && gridX < simMap->width && gridY >= 0 && gridY < simMap->height && input.editCount < MAX_TICK_EDITS) {
+                    input.edits[input.editCount].x = gridX;
+                    input.edits[input.editCount].y = gridY;
+                    input.editCount++;
+                }
+            }
+        }
+        if (quit) {
+            break;
+        }
+        if (mapFileChanged(&mapWatch)) {
+            reloadMap(mapPath);
+        }
+
+        if (replay.data != NULL) {
+            // The recording replaces the keyboard and mouse entirely
+            if (!replayTick(&replay, &input)) {
+                break;
+            }
+        } else {
+            keystate = keyboardState();
+            input.buttons = 0;
+            if (keystate[SDL_SCANCODE_W]) input.buttons |= INPUT_FORWARD;
+            if (keystate[SDL_SCANCODE_S]) input.buttons |= INPUT_BACK;
+            if (keystate[SDL_SCANCODE_A]) input.buttons |= INPUT_LEFT;
+            if (keystate[SDL_SCANCODE_D]) input.buttons |= INPUT_RIGHT;
+            if (modes.terrain) input.buttons |= INPUT_TERRAIN;
+        }
+
+        if (recorder.file != NULL) {
+            recordTick(&recorder, &input);
+        }
+        simulateTick(&player, &input);
+        tick++;
+        if (hashFile != NULL) {
+            fprintf(hashFile, "%u %016llx\n", tick, (unsigned long long)stateHash(&player));
+        }
+
+        if (threaded) {
+            flushEditBacklog();
+            Snapshot snapshot = { player, tick, mapVersion, saveRequests, modes, false };
+            publishSnapshot(&snapshots, &snapshot);
+
+            // Keep a steady tick rate, but don't try to catch up after a long stall
+            nextTick += tickLength;
+            Uint64 now = SDL_GetPerformanceCounter();
+            if (now < nextTick) {
+                SDL_Delay((Uint32)((nextTick - now) * 1000 / SDL_GetPerformanceFrequency()));
+            } else if (now - nextTick > tickLength * 4) {
+                nextTick = now;
+            }
+        } else {
+            setViewModes(&modes);
+            renderWindows(&targets, &player);
+        }
+    }
+
+    if (threaded) {
+        Snapshot last = { player, tick, mapVersion, saveRequests, modes, true };
+        publishSnapshot(&snapshots, &last);
+    }
+    g->player = player;
+    g->replay = replay;
+    g->recorder = recorder;
+    g->tick = tick;
+    g->mapWatch = mapWatch;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: raycastv-4.12 [map.rcm [--watch]] [--record file.rcr | --replay file.rcr] [--hashes file.txt]
+    //                     [--threaded] [--export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)]
+    //                     [--indexed] [--heights] [--light-levels n]
+    //                     [--terrain [height.pgm color.ppm]] [--ray-step n] [--ray-tolerance px]
+    // F3 switches between the solid colour and indexed colour (textured) views,
+    // F4 turns the variable-height view on and off, F5 the terrain view, F6
+    // adaptive ray casting.
+    // F2 saves the (edited) map to the same file, or to map.rcm by default.
+    // --threaded runs the simulation at a fixed SIM_TICK_RATE on a thread of its
+    // own and draws on the main thread, so slow presents no longer delay input.
+    // --watch reloads the map file whenever something else changes it.
+    const char* mapPath = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* hashPath = NULL;
+    const char* exportPath = NULL;
+    const char* cameraPath = NULL;
+    const char* terrainHeightPath = NULL;
+    const char* terrainColorPath = NULL;
+    int levels = DEFAULT_LIGHT_LEVELS;
+    bool threaded = false;
+    bool watch = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--hashes") == 0 && i + 1 < argc) {
+            hashPath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            cameraPath = argv[++i];
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = true;
+        } else if (strcmp(argv[i], "--threaded") == 0) {
+            threaded = true;
+        } else if (strcmp(argv[i], "--indexed") == 0) {
+            indexedMode = true;
+        } else if (strcmp(argv[i], "--heights") == 0) {
+            heightMode = true;
+        } else if (strcmp(argv[i], "--terrain") == 0) {
+            terrainMode = true;
+            if (i + 2 < argc && argv[i + 1][0] != '-' && argv[i + 2][0] != '-') {
+                terrainHeightPath = argv[++i];
+                terrainColorPath = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--ray-step") == 0 && i + 1 < argc) {
+            adaptiveRays = true;
+            rayStep = atoi(argv[++i]);
+            if (rayStep < 2 || rayStep > MAX_RAY_STEP) {
+                printf("--ray-step must be between 2 and %d\n", MAX_RAY_STEP);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ray-tolerance") == 0 && i + 1 < argc) {
+            adaptiveRays = true;
+            rayTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--light-levels") == 0 && i + 1 < argc) {
+            levels = atoi(argv[++i]);
+            if (levels < 2 || levels > MAX_LIGHT_LEVELS) {
+                printf("--light-levels must be between 2 and %d\n", MAX_LIGHT_LEVELS);
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && mapPath == NULL) {
+            mapPath = argv[i];
+        } else {
+            printf("Usage: %s [map.rcm [--watch]] [--record file.rcr | --replay file.rcr] [--hashes file.txt] [--threaded]\n", argv[0]);
+            printf("       %s [map.rcm] --export out.y4m|out.ppm (--replay file.rcr | --path camera.txt)\n", argv[0]);
+            printf("       add --indexed or --heights for the textured views, --light-levels n to set its shading steps\n");
+            printf("       add --terrain [height.pgm color.ppm] for the heightmap terrain view\n");
+            printf("       add --ray-step n (2-%d) to cast every nth column and interpolate the rest,\n", MAX_RAY_STEP);
+            printf("       and --ray-tolerance px to let interpolated walls be off by up to px pixels\n");
+            return 1;
+        }
+    }
+    if (exportPath != NULL && (replayPath == NULL) == (cameraPath == NULL)) {
+        printf("--export needs exactly one of --replay or --path\n");
+        return 1;
+    }
+    if (watch && (mapPath == NULL || recordPath != NULL || replayPath != NULL || exportPath != NULL)) {
+        // Changes made from outside aren't part of a recording
+        printf("--watch needs a map file and can't be used with --record, --replay or --export\n");
+        return 1;
+    }
+    if (mapPath != NULL) {
+        if (!loadMapFile(mapPath, &map)) {
+            return 1;
+        }
+    } else {
+        mapPath = "map.rcm";
+        loadDefaultMap(&map);
+    }
+    if (!allocLightmaps(&lightmaps, map.width, map.height)) {
+        printf("Not enough memory for lightmaps\n");
+        return 1;
+    }
+    bakeAllLightmaps();
+    buildPaletteAndTextures();
+    buildColormap(levels);
+    // Without files the terrain is generated the first time it is shown
+    if (terrainHeightPath != NULL && !loadTerrain(&terrain, terrainHeightPath, terrainColorPath)) {
+        return 1;
+    }
+    // Exports must come out the same every time, so they rebake in line
+    startLightBaker(exportPath != NULL);
+
+    if (exportPath != NULL) {
+        Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+        placePlayer(&player);
+        InputReplay replay = { NULL };
+        if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+            return 1;
+        }
+        int result = runExport(exportPath, &replay, cameraPath, &player);
+        free(replay.data);
+        stopLightBaker();
+        freeLightmaps(&lightmaps);
+        freeMap(&map);
+        return result;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Create main game window
+    SDL_Window* mainWindow = SDL_CreateWindow("Raycasting Game",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+
+    // Create 3D view window
+    SDL_Window* viewWindow = SDL_CreateWindow("3D View",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+
+    // Create map editor window
+    SDL_Window* editorWindow = SDL_CreateWindow("Map Editor",
+        SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, map.width * TILE_SIZE, map.height * TILE_SIZE, SDL_WINDOW_SHOWN);
+
+    Player player = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, 0 };
+    placePlayer(&player);
+
+    InputRecorder recorder = { NULL };
+    InputReplay replay = { NULL };
+    FILE* hashFile = NULL;
+    if (replayPath != NULL && !openReplay(&replay, replayPath, &player)) {
+        return 1;
+    }
+    if (recordPath != NULL && !startRecording(&recorder, recordPath, &player)) {
+        return 1;
+    }
+    if (hashPath != NULL) {
+        hashFile = fopen(hashPath, "w");
+        if (hashFile == NULL) {
+            printf("Could not create hash log %s\n", hashPath);
+            return 1;
+        }
+    }
+
+    Uint32 tick = 0;
+    ViewModes modes = { indexedMode, heightMode, terrainMode, adaptiveRays };
+    Uint32 saveRequests = 0;
+
+    RenderTargets targets = { NULL };
+    if (!createRenderTargets(&targets, mainWindow, viewWindow, editorWindow)) {
+        return 1;
+    }
+    if (threaded) {
+        if (!startCollisionMap()) {
+            printf("Not enough memory for the collision map\n");
+            return 1;
+        }
+        Snapshot first = { player, 0, 0, 0, modes, false };
+        snapshots.slots[0] = first;
+        snapshots.front = 0;
+        SDL_AtomicSet(&snapshots.middle, 1);
+        snapshots.back = 2;
+        eventQueue.active = true;
+    }
+    MapWatch mapWatch = { -1, "" };
+    if (watch) {
+        startMapWatch(&mapWatch, mapPath);
+    }
+
+    GameLoop game = { .mapPath = mapPath, .threaded = threaded, .player = player, .replay = replay,
+        .recorder = recorder, .hashFile = hashFile, .tick = tick, .modes = modes, .saveRequests = saveRequests,
+        .targets = targets, .mapWatch = mapWatch };
+    if (threaded) {
+        SDL_Thread* simulation = SDL_CreateThread(gameLoop, "simulation", &game);
+        if (simulation == NULL) {
+            printf("Could not start the simulation thread! SDL_Error: %s\n", SDL_GetError());
+            return 1;
+        }
+        renderLoop(&targets, mapPath);
+        SDL_WaitThread(simulation, NULL);
+        free(collisionMap.tiles);
+        if (editBacklog.reload != NULL) {
+            freeMap(editBacklog.reload);
+            free(editBacklog.reload);
+        }
+    } else {
+        gameLoop(&game);
+    }
+    player = game.player;
+    replay = game.replay;
+    recorder = game.recorder;
+    tick = game.tick;
+    mapWatch = game.mapWatch;
+
+    stopMapWatch(&mapWatch);
+    destroyRenderTargets(&targets);
+    SDL_DestroyWindow(mainWindow);
+    SDL_DestroyWindow(viewWindow);
+    SDL_DestroyWindow(editorWindow);
+    SDL_Quit();
+
+    if (recorder.file != NULL) {
+        stopRecording(&recorder);
+    }
+    if (hashFile != NULL) {
+        fclose(hashFile);
+    }
+    if (replay.data != NULL) {
+        printf("Replayed %u ticks, final state hash %016llx\n", tick, (unsigned long long)stateHash(&player));
+        free(replay.data);
+    }
+    stopLightBaker();
+    freeLightmaps(&lightmaps);
+    freeTerrain(&terrain);
+    freeMap(&map);
+
+    return 0;
+}